@@ -211,6 +211,7 @@ EX int dirdiff(int dd, int t) {
 EX int cellcount = 0;
 
 EX void destroy_cell(cell *c) {
+  patterns::note_destroyed_cell(c);
   tailored_delete(c);
   cellcount--;
   }
@@ -221,6 +222,7 @@ EX cell *newCell(int type, heptagon *master) {
   c->master = master;
   initcell(c);
   hybrid::will_link(c);
+  patterns::note_new_cell(c);
   cellcount++;
   return c;
   }
@@ -1267,6 +1269,7 @@ EX int clueless_celldistance(cell *c1, cell *c2) {
   return DISTANCE_UNKNOWN;
   }
 
+/** the distance between c1 and c2; in 2D hyperbolic tilings this uses hyperbolic_celldistance, which may be called only from the main thread */
 EX int celldistance(cell *c1, cell *c2) {
 
   if(embedded_plane) return IPF(celldistance(c1, c2));
@@ -150,10 +150,7 @@ EX namespace whirlwind {
   
   EX void move() {
     manual_celllister cl;
-    for(int i=0; i<isize(dcal); i++) {
-      cell *c = dcal[i];
-      moveAt(c, cl);
-      }
+    for(cell *c: dcal_in_land(laWhirlwind)) moveAt(c, cl);
     // Keys and Orbs of Yendor always move
     using namespace yendor;
     for(int i=0; i<isize(yi); i++) {
@@ -1156,10 +1153,7 @@ EX namespace whirlpool {
   
   EX void move() {
     manual_celllister cl;
-    for(int i=0; i<isize(dcal); i++) {
-      cell *c = dcal[i];
-      moveAt(c, cl);
-      }
+    for(cell *c: dcal_in_land(laWhirlpool)) moveAt(c, cl);
     // Keys and Orbs of Yendor always move
     using namespace yendor;
     for(int i=0; i<isize(yi); i++) {
@@ -2983,8 +2977,8 @@ EX namespace kraken {
   EX void attacks() {
     bool offboat[MAXPLAYER];
     for(int i=0; i<MAXPLAYER; i++) offboat[i] = false;
-    for(int i=0; i<isize(dcal); i++) {
-      cell *c = dcal[i];
+    /* krakens move only here and in groupmove(moKrakenH) below, so they are where bfs() found them */
+    for(cell *c: dcal_with_monster(moKrakenT)) {
       if(c->monst == moKrakenT && !c->stuntime) forCellEx(c2, c) {
         if (!logical_adjacent(c2,moKrakenT,c)) continue;
         bool dboat = false;
@@ -3005,8 +2999,8 @@ EX namespace kraken {
         if(dboat) destroyBoats(c2, c, true);
         }
       }
-    for(int i=0; i<isize(dcal); i++) {
-      cell *c = dcal[i];
+    /* a head moved by trymove is on water, so it would not be moved again anyway */
+    for(cell *c: dcal_with_monster(moKrakenH)) {
       if(c->monst == moKrakenH && !c->stuntime && !isWateryOrBoat(c)) {
         vector<cell*> ctab;
         forCellEx(c2, c) if(isWatery(c2)) ctab.push_back(c2);
@@ -3301,10 +3295,8 @@ EX namespace prairie {
   EX void move() {
     if(ls::any_chaos()) return;
     manual_celllister cl;
-    for(int i=0; i<isize(dcal); i++) {
-      cell *c = dcal[i];
+    for(cell *c: dcal_in_land(laPrairie))
       if(isriver(c)) moveAt(c, cl);
-      }
     for(int i=0; i<isize(beaststogen); i++)
       generateBeast(beaststogen[i]);
     beaststogen.clear();
@@ -261,7 +261,7 @@ EX namespace westwall {
   EX void move() {
     manual_celllister cl;
     if(gravity_state == gsLevitation) return;
-    for(cell *c: dcal) moveAt(c, cl);
+    for(cell *c: dcal_in_land(laWestWall)) moveAt(c, cl);
     // Keys and Orbs of Yendor always move
     using namespace yendor;
     for(int i=0; i<isize(yi); i++) {
@@ -709,15 +709,15 @@ EX bool ambushed;
 EX void check_state() {
   if(havewhat & HF_HUNTER) {
     manual_celllister cl;
-    for(cell *c: dcal) {
-      if(c->monst == moHunterDog) {
-        if(c->cpdist > distance)
-          distance = c->cpdist;
-        mark(c, cl);
-        }
+    /* the hunters have not moved since bfs(), and the marked cells do not depend on the order */
+    for(cell *c: dcal_with_monster(moHunterDog)) if(c->monst == moHunterDog) {
+      if(c->cpdist > distance)
+        distance = c->cpdist;
+      mark(c, cl);
+      }
+    for(cell *c: dcal_with_monster(moHunterGuard))
       if(c->monst == moHunterGuard && c->cpdist <= 4) 
         mark(c, cl);
-      }
     if(items[itHunting] > 5 && items[itHunting] <= 22) {
       int q = 0;
       for(cell *pc: player_positions()) 
@@ -830,6 +830,13 @@ int read_cheat_args() {
     fixseed = true; autocheat = true;
     shift(); startseed = argi();
     }
+  else if(argis("-cellrng")) {
+    PHASEFROM(2);
+    stop_game();
+    cell_rng_mode = true;
+    /* only deterministic in the single land structure, see cell_rng_mode */
+    land_structure = lsSingle;
+    }
   else if(argis("-reseed")) {
     PHASEFROM(2);
     shift(); shrand(argi());
@@ -52,6 +52,36 @@ int readArgs() {
     
     println(hlog, "cells checked: ", q, " errors: ", errors, " unknown: ", unknown, " in: ", full_geometry_name());
     
+    if(errors) exit(1);
+    }
+  else if(argis("-test-far-dist")) {
+    /* compare celldistance with and without the skip pointers on random far pairs, e.g.
+       -test-far-dist 40 1000, -gp 2 1 -test-far-dist 40 1000, -irrmap ... -test-far-dist 40 1000 */
+    PHASEFROM(3);
+    start_game();
+    shift(); int len = argi();
+    shift(); int pairs = argi();
+    auto random_far = [&] {
+      cell *c = cwt.at;
+      for(int i=0; i<len; i++) c = c->cmove(hrand(c->type));
+      return c;
+      };
+    int maxd = 0;
+    for(int i=0; i<pairs; i++) {
+      cell *c1 = random_far(), *c2 = random_far();
+      /* the cache would return the result of the other method */
+      dynamicval<int> dc(celldistance_cache_size, 0);
+      dynamicval<bool> ds(celldistance_skip_levels, false);
+      int walked = celldistance(c1, c2);
+      celldistance_skip_levels = true;
+      int skipped = celldistance(c1, c2);
+      maxd = max(maxd, walked);
+      if(walked != skipped) {
+        errors++;
+        println(hlog, "distance error: ", tie(c1, c2), " walked = ", walked, " skipped = ", skipped);
+        }
+      }
+    println(hlog, "pairs checked: ", pairs, " max distance: ", maxd, " errors: ", errors, " in: ", full_geometry_name());
     if(errors) exit(1);
     }
   else if(argis("-test-bt")) {
@@ -104,7 +134,419 @@ int readArgs() {
     if(errors) exit(1);
     }
 
-  else if(argis("-partest", [] {
+  else if(argis("-test-compiled-exp")) {
+    vector<pair<string, ld>> known = {
+      {"1+2*3-4/5", 6.2}, {"sin(pi/2)^2+cos(1)", 1 + cos(1)}, {"let(t=2,t*t+t)", 6}, {"min(3,1,2)+max(1,5)", 6},
+      {"ifp(1-2,5,7)+ifz(0,1,2)", 8}, {"-3+4*-2", -11}, {"frac(2.75)+floor(2.5)", 2.75}, {"to01(0)", 0.5},
+      {"re(exp(i*pi))", -1}, {"0x10+deg", 16 + degree}, {"let(a=1,a)+let(b=2,b*3)", 7}, {"let(a=1,let(b=a+1,a*10+b))", 12}
+      };
+    for(auto& k: known) {
+      ld interpreted = parseld(k.first);
+      compiled_exp ce = compile_exp(k.first, {});
+      vector<cld> frame(ce.frame_size + 1);
+      ld compiled = ce.eval_real(&frame[0]);
+      if(abs(interpreted - k.second) > 1e-9 || abs(compiled - k.second) > 1e-9) errors++;
+      println(hlog, k.first, ": ", interpreted, " / ", compiled, " expected ", k.second);
+      }
+    exp_parser ep;
+    ep.extra_params["x"] = 3;
+    ep.s = "x*x+let(y=x,y)";
+    if(abs(ep.rparse() - 12) > 1e-9) errors++;
+    try { parseld("1+floor(i)"); errors++; }
+    catch(hr_parse_exception& e) {
+      println(hlog, "error: ", e.s);
+      if(e.s.find("pos") == string::npos) errors++;
+      }
+    compiled_exp ce = compile_exp("x*y+let(y=3,y)", {"x", "y"});
+    vector<cld> frame(ce.frame_size);
+    frame[0] = 2; frame[1] = 5;
+    ld v = ce.eval_real(&frame[0]);
+    println(hlog, "with slots: ", v);
+    if(v != 13) errors++;
+    /* function arguments are kept in frame slots, which nested calls and lets must not overwrite */
+    compiled_exp nested = compile_exp("min(x,let(t=x+1,max(t,x*2)))+let(u=max(x,1),u+min(u,2))", {"x"});
+    vector<cld> nframe(nested.frame_size);
+    nframe[0] = 3;
+    ld nv = nested.eval_real(&nframe[0]);
+    println(hlog, "nested calls: ", nv);
+    if(nv != 8) errors++;
+    /* the value of a compiled formula follows the geometry in which it is evaluated */
+    PHASEFROM(2);
+    compiled_exp geo = compile_exp("regangle(0.5,4)", {});
+    vector<cld> gframe(geo.frame_size);
+    vector<ld> seen;
+    for(eGeometry g: {gNormal, gEuclidSquare, gSphere}) {
+      stop_game();
+      set_geometry(g);
+      ld compiled = geo.eval_real(&gframe[0]);
+      ld interpreted = parseld("regangle(0.5,4)");
+      println(hlog, geometry_name(), ": ", interpreted, " / ", compiled);
+      if(abs(compiled - interpreted) > 1e-9) errors++;
+      for(ld s: seen) if(abs(s - compiled) < 1e-3) errors++;
+      seen.push_back(compiled);
+      }
+    if(errors) exit(1);
+    }
+
+  else if(argis("-test-cellbfs")) {
+    PHASEFROM(3);
+    start_game();
+    shift(); int d = argi();
+    celllister cl(cwt.at, d, 1000000, nullptr);
+    cellbfs bfs(cwt.at, d, 1000000, nullptr);
+    if(cl.lst != bfs.lst || cl.dists != bfs.dists) errors++;
+    /* nested traversals are allowed */
+    for(cell *c: bfs.lst) {
+      cellbfs inner(c, 2, 1000000, nullptr, false);
+      for(cell *c1: inner.lst) if(inner.getdist(c1) > 2) errors++;
+      }
+    auto all = bfs.lst;
+    for(int threads: {1, 4}) {
+      cellbfs par;
+      par.parallel(cwt.at, d, threads);
+      if(par.lst != bfs.lst || par.dists != bfs.dists) errors++;
+      par.parallel(cwt.at, d, threads, &all);
+      for(cell *c: bfs.lst) if(!par.listed(c) || par.getdist(c) != bfs.getdist(c)) errors++;
+      }
+    println(hlog, "cells checked: ", isize(bfs.lst), " errors: ", errors);
+    if(errors) exit(1);
+    }
+
+  else if(argis("-test-cell-rng")) {
+    /* generate the same region in two different orders, e.g. -test-cell-rng 10; in -cellrng mode the results should agree */
+    /* (-cellrng is used only in the single land structure, see cell_rng_mode) */
+    PHASEFROM(3);
+    shift(); int d = argi();
+    map<unsigned long long, tuple<eLand, eWall, eMonster, eItem>> first;
+    int compared = 0;
+    for(int pass=0; pass<2; pass++) {
+      stop_game();
+      cell_rng_mode = true;
+      land_structure = lsSingle;
+      start_game();
+      celllister cl(cwt.at, d, 1000000, nullptr);
+      vector<cell*> order = cl.lst;
+      if(pass) reverse(order.begin(), order.end());
+      for(cell *c: order) setdist(c, 0, nullptr);
+      for(cell *c: cl.lst) {
+        unsigned long long addr;
+        if(!cell_address(c, addr)) continue;
+        auto val = make_tuple(eLand(c->land), eWall(c->wall), eMonster(c->monst), eItem(c->item));
+        if(pass == 0) { first[addr] = val; continue; }
+        if(!first.count(addr)) continue;
+        compared++;
+        if(first[addr] != val) errors++;
+        }
+      }
+    println(hlog, "cells compared: ", compared, " errors: ", errors, " in: ", full_geometry_name());
+    if(errors || !compared) exit(1);
+    }
+
+  else if(argis("-test-bignum")) {
+    /* small numbers, handled by the fast path */
+    bignum x; long long lx = 0;
+    for(int i=0; i<1000; i++) {
+      int v = hrand(bignum::BASE);
+      x += v; lx += v;
+      if(x.approx_ll() != lx) errors++;
+      }
+    for(int i=0; i<1000; i++) {
+      int f = 1 + hrand(20);
+      x.addmul(bignum(1000), -f); lx -= 1000 * f;
+      if(x.approx_ll() != lx) errors++;
+      }
+    /* powers of two, going through the general path and back */
+    vector<bignum> pw(1, bignum(1));
+    for(int i=0; i<300; i++) { bignum y = pw.back(); y += pw.back(); pw.push_back(y); }
+    for(int i=300; i>0; i--) {
+      bignum y = pw[i];
+      y.addmul(pw[i-1], -1);
+      if(y < pw[i-1] || pw[i-1] < y) errors++;
+      }
+    if(pw[62].approx_ll() != bignum::BASE2 || pw[59].approx_ll() != (1ll << 59)) errors++;
+    println(hlog, "2^300 = ", pw[300].get_str(1000), " errors: ", errors);
+    if(errors) exit(1);
+    }
+
+  else if(argis("-test-expansion")) {
+    /* the Berlekamp-Massey path should find the same recurrence as the Gaussian elimination, on a few tilings */
+    PHASEFROM(2);
+    dynamicval<string> dc(expansion_cache_file, "");
+    vector<pair<eGeometry, eVariation>> tilings = {
+      {gNormal, eVariation::bitruncated}, {gNormal, eVariation::pure}, {gOctagon, eVariation::pure},
+      {g45, eVariation::pure}, {g46, eVariation::bitruncated}, {gEuclidSquare, eVariation::pure}
+      };
+    for(auto t: tilings) {
+      stop_game();
+      set_geometry(t.first);
+      set_variation(t.second);
+      start_game();
+      auto& ea = get_expansion();
+      if(!ea.N) ea.preliminary_grouping(), ea.reduce_grouping();
+      if(!ea.find_coefficients_bm()) { println(hlog, full_geometry_name(), ": not found"); errors++; continue; }
+      auto coef = ea.coef;
+      int valid_from = ea.valid_from;
+      if(!ea.find_coefficients_gauss() || ea.coef != coef || ea.valid_from != valid_from) errors++;
+      println(hlog, full_geometry_name(), ": coefficients ", coef, " / ", ea.coef, " valid from ", valid_from, " / ", ea.valid_from);
+      }
+    if(errors) exit(1);
+    }
+
+  #if CAP_RACING
+  else if(argis("-test-ghost-codec")) {
+    /* record a random walk in current_history, encode it, and decode it again, in chunks and from a truncated stream */
+    PHASEFROM(3);
+    start_game();
+    using namespace racing;
+    auto& h = current_history[0];
+    h.clear();
+    cell *c = cwt.at;
+    int step = 0;
+    uchar v[4] = {0, 0, 0, 0};
+    for(int i=0; i<1000; i++) {
+      step += hrand(10) ? 16 + hrand(2) : hrand(1000);
+      if(hrand(4) == 0) c = c->cmove(hrand(c->type));
+      else if(hrand(50) == 0) { c = c->cmove(hrand(c->type)); c = c->cmove(hrand(c->type)); }
+      for(int j=0; j<4; j++) if(hrand(2)) v[j] += hrand(3) ? hrand(15) - 7 : hrand(256);
+      h.push_back(ghostmoment{step, c, v[0], v[1], v[2], v[3]});
+      }
+    auto same = [] (const ghostmoment& a, const ghostmoment& b) {
+      return a.step == b.step && a.where_cell == b.where_cell && a.alpha == b.alpha && a.distance == b.distance && a.beta == b.beta && a.footphase == b.footphase;
+      };
+    vector<cell*> jumps;
+    string data = encode_history(h, jumps);
+    for(int trunc=0; trunc<2; trunc++) {
+      ghost gh;
+      gh.stream = ghost_stream{trunc ? data.substr(0, isize(data) / 2) : data, 0, jumps, 0, 0, isize(h)};
+      decode_moments(gh, 256);
+      if(isize(gh.history) != 256) errors++;
+      while(gh.stream.left > 0) decode_moments(gh, 256);
+      if(trunc ? isize(gh.history) >= isize(h) : isize(gh.history) != isize(h)) errors++;
+      for(int i=0; i<isize(gh.history) && i<isize(h); i++) if(!same(gh.history[i], h[i])) errors++;
+      println(hlog, trunc ? "truncated" : "full", ": ", isize(gh.history), " of ", isize(h), " moments decoded");
+      }
+    h.clear();
+    println(hlog, "bytes: ", isize(data), " jumps: ", isize(jumps), " errors: ", errors);
+    if(errors) exit(1);
+    }
+  #endif
+
+  #if CAP_SAVE
+  else if(argis("-test-score-index")) {
+    /* a record appended in two parts (as when another process is writing the scorefile) should be indexed once, and completely */
+    shift(); string fname = args();
+    dynamicval<string> ds(scorefile, fname);
+    remove(fname.c_str()); remove((fname + ".idx").c_str());
+    auto append = [&] (const string& s) {
+      FILE *f = fopen(fname.c_str(), "at");
+      if(!f) { println(hlog, "cannot write ", fname); exit(1); }
+      fputs(s.c_str(), f);
+      fclose(f);
+      };
+    string header = "HyperRogue: game statistics (version 12.0)\n";
+    string boxes = "12.0 1 2 12";
+    append(header + boxes);
+    if(!scores::update_index() || scores::index_size() != 0 || scores::index_text_pos() != 0) errors++;
+    string rest = "3";
+    for(int i=3; i<30; i++) rest += " " + its(i);
+    append(rest + "\n\n");
+    if(!scores::update_index() || scores::index_size() != 1) errors++;
+    else {
+      /* box 0 is taken from box 65 in new versions, so the first box that keeps its value is box 1 */
+      if(scores::index_box(0, 1) != 2 || scores::index_box(0, 2) != 123 || scores::index_box(0, 29) != 29) errors++;
+      if(scores::index_text_pos() != isize(header) + isize(boxes) + isize(rest) + 2) errors++;
+      }
+    scores::update_index();
+    if(scores::index_size() != 1) errors++;
+    println(hlog, "records: ", scores::index_size(), " errors: ", errors);
+    remove(fname.c_str()); remove((fname + ".idx").c_str());
+    if(errors) exit(1);
+    }
+  #endif
+
+  else if(argis("-bench-draw-distance")) {
+    /* e.g. -geo Nil -bench-draw-distance 12 */
+    PHASEFROM(3);
+    start_game();
+    shift(); int d = argi();
+    celllister cl(cwt.at, d, 1000000, nullptr);
+    vector<pair<cell*, shiftmatrix>> batch;
+    for(cell *c: cl.lst) batch.emplace_back(c, shiftless(calc_relative_matrix(c, cwt.at, C0)));
+    int N = isize(batch);
+    vector<ld> serial(N), batched;
+    /* the serial per-cell computation used by do_draw before draw_distances */
+    auto t0 = SDL_GetTicks();
+    for(int i=0; i<N; i++) serial[i] = hypot_d(3, inverse_exp(tC0(batch[i].second), pQUICK));
+    auto t1 = SDL_GetTicks();
+    draw_distances(batch, batched);
+    auto t2 = SDL_GetTicks();
+    /* beyond the limit, draw_distance may return a lower bound, but it must still be beyond the limit */
+    ld limit = sightranges[geometry] + (vid.sloppy_3d ? 0 : nil ? 0.9 : cgi.corner_bonus);
+    for(int i=0; i<N; i++) {
+      if(serial[i] <= limit ? batched[i] != serial[i] : batched[i] <= limit) errors++;
+      }
+    println(hlog, "cells: ", N, " serial: ", int(t1-t0), " ms batched: ", int(t2-t1), " ms errors: ", errors);
+    if(errors) exit(1);
+    }
+
+  else if(argis("-bench-reg3")) {
+    /* e.g. -bench-reg3 200000: generate the given number of cells around the start in each hyperbolic reg3 geometry, without the rules
+       (a number rather than a radius, since the honeycombs grow at very different rates) */
+    PHASEFROM(3);
+    shift(); int n = argi();
+    dynamicval<int> cr(reg3::consider_rules, 0);
+    for(eGeometry g: {gSpace534, gSpace435, gSpace535, gSpace536, gSpace436, gSpace336, gSpace344, gSpace345, gSpace353, gSpace354, gSpace355}) {
+      stop_game();
+      set_geometry(g);
+      /* start_game already generates most of the cells, so it is timed too */
+      auto t0 = SDL_GetTicks();
+      start_game();
+      auto t1 = SDL_GetTicks();
+      manual_celllister cl;
+      cl.add(cwt.at);
+      for(int i=0; i<isize(cl.lst) && isize(cl.lst) < n; i++)
+        forCellCM(c2, cl.lst[i]) cl.add(c2);
+      auto t2 = SDL_GetTicks();
+      println(hlog, lalign(30, full_geometry_name()), " cells: ", isize(cl.lst), " start: ", int(t1-t0), " ms listing: ", int(t2-t1), " ms", reg3::in_hrmap_h3() ? "" : " (not hrmap_h3)");
+      }
+    }
+
+  #if MAXMDIM >= 4
+  else if(argis("-bench-subcubes")) {
+    /* e.g. -geo 435 -to-fq p 5 EB201050 -bench-subcubes 1 3: build the closed manifold for each subdivision in the given range */
+    PHASEFROM(3);
+    shift(); int lo = argi();
+    shift(); int hi = argi();
+    for(auto v: {eVariation::subcubes, eVariation::dual_subcubes, eVariation::bch})
+    for(int sub=lo; sub<=hi; sub++) {
+      stop_game();
+      set_variation(v);
+      reg3::subcube_count = sub;
+      auto t0 = SDL_GetTicks();
+      start_game();
+      auto t1 = SDL_GetTicks();
+      auto& ac = currentmap->allcells();
+      int missing = 0;
+      for(cell *c: ac) for(int i=0; i<c->type; i++) if(!c->move(i)) missing++;
+      println(hlog, "variation: ", int(v), " subcubes: ", sub, " cells: ", isize(ac), " time: ", int(t1-t0), " ms missing: ", missing);
+      errors += missing;
+      }
+    if(errors) exit(1);
+    }
+  #endif
+
+  #if MAXMDIM >= 4 && CAP_GL
+  else if(argis("-bench-sky")) {
+    /* in 2.5D, e.g. -geo oox3 -bench-sky 5: generate the sky mesh for all cells within the given distance */
+    PHASEFROM(3);
+    start_game();
+    shift(); int d = argi();
+    for(int rep=0; rep<3; rep++) {
+      auto t0 = SDL_GetTicks();
+      int q = compute_sky_for(d);
+      auto t1 = SDL_GetTicks();
+      println(hlog, "vertices: ", q, " time: ", int(t1-t0), " ms (", q / max<int>(t1-t0, 1), " per ms)");
+      }
+    }
+  #endif
+
+  else if(argis("-bench-shvid")) {
+    /* e.g. -gp 3 1 -bench-shvid 12: compute the shape ids of all cells within the given distance, with the shape cache cold and warm,
+       and compare them with the ids computed with the cache cleared before every cell */
+    PHASEFROM(3);
+    start_game();
+    shift(); int d = argi();
+    celllister cl(cwt.at, d, 1000000, nullptr);
+    vector<int> ref, cold, warm;
+    for(cell *c: cl.lst) { clear_shape_cache(); ref.push_back(shvid(c)); }
+    clear_shape_cache();
+    auto t0 = SDL_GetTicks();
+    for(cell *c: cl.lst) cold.push_back(shvid(c));
+    auto t1 = SDL_GetTicks();
+    for(cell *c: cl.lst) warm.push_back(shvid(c));
+    auto t2 = SDL_GetTicks();
+    for(int i=0; i<isize(ref); i++) if(cold[i] != ref[i] || warm[i] != ref[i]) errors++;
+    println(hlog, "cells: ", isize(cl.lst), " cold: ", int(t1-t0), " ms warm: ", int(t2-t1), " ms errors: ", errors);
+    if(errors) exit(1);
+    }
+
+  else if(argis("-bench-fake-adj")) {
+    /* e.g. -geo 534 -coxeter 1 -gfake 5 -bench-fake-adj 6: compare adj with and without the cache */
+    PHASEFROM(3);
+    start_game();
+    shift(); int d = argi();
+    celllister cl(cwt.at, d, 1000000, nullptr);
+    vector<transmatrix> uncached, cached;
+    auto compute = [&] (vector<transmatrix>& res) {
+      res.clear();
+      for(cell *c: cl.lst) for(int i=0; i<c->type; i++) if(c->move(i)) res.push_back(currentmap->adj(c, i));
+      };
+    dynamicval<bool> ca(fake::cache_adj, false);
+    auto t0 = SDL_GetTicks();
+    compute(uncached);
+    auto t1 = SDL_GetTicks();
+    fake::cache_adj = true;
+    fake::clear_adj_cache();
+    compute(cached);
+    auto t2 = SDL_GetTicks();
+    compute(cached);
+    auto t3 = SDL_GetTicks();
+    for(int i=0; i<isize(cached); i++) if(!eqmatrix(cached[i], uncached[i])) errors++;
+    println(hlog, "edges: ", isize(cached), " uncached: ", int(t1-t0), " ms cold cache: ", int(t2-t1), " ms warm cache: ", int(t3-t2), " ms errors: ", errors);
+    if(errors) exit(1);
+    }
+
+  #if CAP_RAY && MAXMDIM >= 4
+  else if(argis("-bench-intra")) {
+    /* e.g. -intra-solv 5 5 -bench-intra 20000 (the spaces of -intra-floors are not connected by portals):
+       list the cells through portals, and then visit their neighbors, as generate_cell_listing and generate_connections do in the raycaster */
+    PHASEFROM(3);
+    shift(); int n = argi();
+    if(!intra::in) { println(hlog, "not in intra"); return 0; }
+    intra::resetter ir;
+    if(isize(intra::data) > 1) {
+      auto t0 = SDL_GetTicks();
+      for(int i=0; i<10000; i++) intra::switch_to(i & 1);
+      auto t1 = SDL_GetTicks();
+      intra::switch_to(ir.ic);
+      println(hlog, "10000 switches: ", int(t1-t0), " ms");
+      }
+    for(int rep=0; rep<3; rep++) {
+      int sw0 = intra::switches;
+      auto t0 = SDL_GetTicks();
+      manual_celllister cl;
+      cl.add(centerover);
+      for(int i=0; i<isize(cl.lst) && isize(cl.lst) < n; i++) {
+        cell *c = cl.lst[i];
+        intra::may_switch_to(c);
+        forCellIdCM(c2, d, c) {
+          if(!intra::intra_id.count(c2)) intra::intra_id[c2] = intra::current;
+          auto p = at_or_null(intra::connections, cellwalker(c, d));
+          if(p) cl.add(p->tcw.at);
+          cl.add(c2);
+          }
+        }
+      int sw1 = intra::switches;
+      auto t1 = SDL_GetTicks();
+      int total = 0;
+      ld mtotal = 0;
+      for(cell *c: cl.lst) {
+        intra::may_switch_to(c);
+        forCellIdEx(c2, d, c) {
+          auto p = at_or_null(intra::connections, cellwalker(c, d));
+          total += intra::full_wall_offset(p ? p->tcw.at : c2);
+          if(!p) mtotal += currentmap->iadj(c, d)[0][0];
+          }
+        }
+      int sw2 = intra::switches;
+      auto t2 = SDL_GetTicks();
+      println(hlog, "cells: ", isize(cl.lst), " spaces: ", isize(intra::data), " listing: ", int(t1-t0), " ms ", sw1-sw0, " switches; visiting: ",
+        int(t2-t1), " ms ", sw2-sw1, " switches; checksum: ", total, " ", mtotal);
+      }
+    }
+  #endif
+
+  else if(argis("-partest")) {
     hyperpoint h = point31(.01, .05, 0);
     if(LDIM == 3) h[2] = .015;
     println(hlog, "h = ", h);
@@ -116,7 +558,7 @@ int readArgs() {
       println(hlog, "min Ph = ", bt::bt_to_minkowski(h));
       println(hlog, "min DPh = ", test_eq(h, bt::minkowski_to_bt(bt::bt_to_minkowski(h))));
       }
-    });
+    }
 
   else return 1;
   return 0;
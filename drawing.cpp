@@ -97,6 +97,31 @@ struct dqi_poly : drawqueueitem {
   color_t outline_group() override { return outline; }
   };
 
+/** \brief Drawqueueitem used to draw many copies of the same shape (snowballs, particles, etc.) as a single queue item.
+ *
+ *  The shape data (tab, offset, cnt, flags, tinf...) is shared, and every instance has its own transformation and colors.
+ *  V, color and outline are those of the first instance, so that sorting works as for dqi_poly.
+ */
+struct dqi_poly_instanced : dqi_poly {
+  struct instance {
+    shiftmatrix V;
+    color_t color;
+    color_t outline;
+    };
+  /** \brief the instances to draw */
+  vector<instance> instances;
+  /** \brief add an instance of the shape, with the given transformation and color */
+  void add(const shiftmatrix& V1, color_t col);
+  void draw() override;
+  void draw_back() override;
+  #if CAP_GL
+  /** \brief can all the instances be sent to GL at once? */
+  bool can_batch();
+  /** \brief send all the instances to GL at once, as a single array of pretransformed and colored vertices */
+  void gldraw_instanced();
+  #endif
+  };
+
 /** \brief Drawqueueitem used to draw lines */
 struct dqi_line : drawqueueitem {
   /** \brief starting and ending point */
@@ -2214,6 +2239,110 @@ void dqi_poly::draw_back() {
   draw();
   }
 
+void dqi_poly_instanced::add(const shiftmatrix& V1, color_t col) {
+  instance in;
+  in.V = V1;
+  apply_neon_color(col, in.color, in.outline, flags);
+  if(instances.empty()) V = V1, color = in.color, outline = in.outline;
+  instances.push_back(in);
+  }
+
+#if CAP_GL
+bool dqi_poly_instanced::can_batch() {
+  if(!vid.usingGL || instances.empty() || tinf || !(flags & POLY_TRIANGLES)) return false;
+  if((flags & POLY_DEBUG) || (debugflags & DF_VERTEX)) return false;
+  #if CAP_ODS
+  if(vid.stereo_mode == sODS) return false;
+  #endif
+  if(sl2 || in_s2xe() || models::get_broken_coord(pmodel)) return false;
+  if(sphere && (stretch::factor || ray::in_use)) return false;
+  for(auto& in: instances) if(in.V.shift != instances[0].V.shift) return false;
+  current_display->set_all(global_projection, instances[0].V.shift);
+  return get_shader_flags() & SF_DIRECT;
+  }
+
+void dqi_poly_instanced::gldraw_instanced() {
+  GLWRAP;
+  glflush();
+  auto& v = *tab;
+  static vector<glhr::colored_vertex> tris, lines;
+  tris.clear(); lines.clear();
+  ld scale = (flags & POLY_INTENSE) ? 2 : 1;
+  flagtype sp = get_shader_flags();
+
+  auto add_vertex = [] (vector<glhr::colored_vertex>& to, const transmatrix& T, const glvertex& g, const array<GLfloat, 4>& col) {
+    glhr::colored_vertex cv;
+    cv.coords = glhr::pointtogl(T * glhr::gltopoint(g));
+    for(int i=0; i<4; i++) cv.color[i] = col[i];
+    to.push_back(cv);
+    };
+
+  for(auto& in: instances) {
+    if((sp & SF_BAND) && in.V[2][2] > 1e8) continue;
+    if(in.color) {
+      auto col = glhr::acolor(in.color, scale);
+      for(int i=0; i<cnt; i++) add_vertex(tris, in.V.T, v[offset+i], col);
+      }
+    if(in.outline) {
+      auto col = glhr::acolor(in.outline);
+      for(int i=0; i+2<cnt; i+=3) for(int j=0; j<3; j++) {
+        add_vertex(lines, in.V.T, v[offset+i+j], col);
+        add_vertex(lines, in.V.T, v[offset+i+(j+1)%3], col);
+        }
+      }
+    }
+
+  if(tris.empty() && lines.empty()) return;
+  set_width(get_width(this));
+
+  for(int ed = current_display->stereo_active() ? -1 : 0; ed<2; ed+=2) {
+    if(global_projection && global_projection != ed) continue;
+    current_display->next_shader_flags = GF_VARCOLOR;
+    if(flags & POLY_NO_FOG) current_display->next_shader_flags |= GF_NO_FOG;
+    current_display->set_all(ed, instances[0].V.shift);
+    glhr::set_index_sl(instances[0].V.shift);
+    glapplymatrix(Id);
+    glhr::set_depthtest(model_needs_depth() && prio < PPR::SUPERLINE);
+    glhr::set_depthwrite(model_needs_depth() && prio != PPR::TRANSPARENT_SHADOW && prio != PPR::EUCLIDEAN_SKY);
+    glhr::set_fogbase(prio == PPR::SKY ? 1.0 + (euclid ? 20 : 5 / sightranges[geometry]) : 1.0);
+    for(auto p: {&tris, &lines}) if(!p->empty()) {
+      glhr::current_vertices = NULL;
+      glhr::prepare(*p);
+      glDrawArrays(p == &tris ? GL_TRIANGLES : GL_LINES, 0, isize(*p));
+      }
+    }
+  glhr::current_vertices = NULL;
+  }
+#endif
+
+void dqi_poly_instanced::draw() {
+  #if CAP_GL
+  if(can_batch()) { gldraw_instanced(); return; }
+  #endif
+  /* other renderers: draw the instances one by one, reusing this item */
+  dynamicval<shiftmatrix> dv(V, V);
+  dynamicval<color_t> dc(color, color);
+  dynamicval<color_t> doc(outline, outline);
+  dynamicval<int> df(flags, flags);
+  dynamicval<int> dcnt(cnt, cnt);
+  int f = flags, c = cnt;
+  for(auto& in: instances) {
+    V = in.V; color = in.color; outline = in.outline;
+    flags = f; cnt = c;
+    dqi_poly::draw();
+    }
+  }
+
+void dqi_poly_instanced::draw_back() {
+  vector<instance> front = instances;
+  for(auto& in: instances) {
+    in.color = darken_color(in.color, false);
+    in.outline = darken_color(in.outline, true);
+    }
+  draw();
+  instances = std::move(front);
+  }
+
 void dqi_line::draw_back() { 
   dynamicval<color_t> dvc(color, darken_color(color, true));
   draw();
@@ -2593,16 +2722,10 @@ template<class T, class... U> T& queuea(PPR prio, U... u) {
 #endif
 
 #if CAP_SHAPES
-EX dqi_poly& queuepolyat(const shiftmatrix& V, const hpcshape& h, color_t col, PPR prio) {
-  if(prio == PPR::DEFAULT) prio = h.prio;
-
-  auto& ptd = queuea<dqi_poly> (prio);
-
-  ptd.V = V;
+void set_shape(dqi_poly& ptd, const hpcshape& h) {
   ptd.offset = h.s;
   ptd.cnt = h.e-h.s;
   ptd.tab = &cgi.ourshape;
-  apply_neon_color(col, ptd.color, ptd.outline, h.flags);
   ptd.linewidth = vid.linewidth;
   ptd.flags = h.flags;
   ptd.tinf = h.tinf;
@@ -2611,6 +2734,28 @@ EX dqi_poly& queuepolyat(const shiftmatrix& V, const hpcshape& h, color_t col, P
   ptd.apeiro_cnt = h.she - h.s;
   ptd.offset_texture = h.texture_offset;
   ptd.intester = h.intester;
+  }
+
+EX dqi_poly& queuepolyat(const shiftmatrix& V, const hpcshape& h, color_t col, PPR prio) {
+  if(prio == PPR::DEFAULT) prio = h.prio;
+
+  auto& ptd = queuea<dqi_poly> (prio);
+
+  ptd.V = V;
+  set_shape(ptd, h);
+  apply_neon_color(col, ptd.color, ptd.outline, h.flags);
+  return ptd;
+  }
+
+/** \brief queue an empty instanced item for shape h; add the instances with dqi_poly_instanced::add */
+EX dqi_poly_instanced& queuepoly_instanced(const hpcshape& h, PPR prio IS(PPR::DEFAULT)) {
+  if(prio == PPR::DEFAULT) prio = h.prio;
+
+  auto& ptd = queuea<dqi_poly_instanced> (prio);
+
+  ptd.V = shiftless(Id);
+  set_shape(ptd, h);
+  ptd.color = ptd.outline = 0;
   return ptd;
   }
 #endif
@@ -60,6 +60,41 @@ EX int first7;
 /** the list of all nearby cells, according to cpdist */
 EX vector<cell*> dcal;
 
+/** the cells of dcal, bucketed by land, in the dcal order; built in bfs() */
+vector<vector<cell*>> dcal_by_land;
+
+/** the cells of dcal in the given land, in the dcal order. Lands do not change during a turn, so this stays valid until the next bfs() */
+EX const vector<cell*>& dcal_in_land(eLand l) {
+  static const vector<cell*> none;
+  if(l >= isize(dcal_by_land)) return none;
+  return dcal_by_land[l];
+  }
+
+/** the cells of dcal, bucketed by their monster at the end of bfs(), in the dcal order */
+vector<vector<cell*>> dcal_by_monster;
+
+/** the cells of dcal which had monster m at the end of the last bfs(), in the dcal order.
+ *  Monsters move, appear and die during the turn, so these are only candidates: check c->monst on use,
+ *  and use this only in the passes where no monster of type m could have moved or appeared since bfs().
+ */
+EX const vector<cell*>& dcal_with_monster(eMonster m) {
+  static const vector<cell*> none;
+  if(m >= isize(dcal_by_monster)) return none;
+  return dcal_by_monster[m];
+  }
+
+EX void clear_dcal() {
+  dcal.clear();
+  for(auto& v: dcal_by_land) v.clear();
+  for(auto& v: dcal_by_monster) v.clear();
+  }
+
+void add_to_dcal(cell *c) {
+  dcal.push_back(c);
+  if(c->land >= isize(dcal_by_land)) dcal_by_land.resize(c->land + 1);
+  dcal_by_land[c->land].push_back(c);
+  }
+
 /** the list of all nearby cells, according to current pathdist */
 EX vector<cellwalker> pathq;
 
@@ -328,7 +363,7 @@ EX void bfs() {
   airmap.clear();
   if(!(hadwhat & HF_ROSE)) rosemap.clear();
   
-  dcal.clear(); bfs_reachedfrom.clear();
+  clear_dcal(); bfs_reachedfrom.clear();
 
   recalcTide = false;
   
@@ -336,7 +371,7 @@ EX void bfs() {
     if(c->cpdist == 0) continue;
     c->cpdist = 0;
     checkTide(c);
-    dcal.push_back(c);
+    add_to_dcal(c);
     bfs_reachedfrom.push_back(hrand(c->type));
     if(!invismove) targets.push_back(c);
     }
@@ -433,7 +468,7 @@ EX void bfs() {
           }
         
         if(!keepLightning) c2->ligon = 0;
-        dcal.push_back(c2);
+        add_to_dcal(c2);
         bfs_reachedfrom.push_back(c->c.spin(i));
         
         checkTide(c2);
@@ -551,10 +586,16 @@ EX void bfs() {
 
   while(recalcTide) {
     recalcTide = false;
-    for(int i=0; i<isize(dcal); i++) checkTide(dcal[i]);
+    /* checkTide only affects these lands */
+    for(eLand l: {laOcean, laVolcano}) for(cell *c: dcal_in_land(l)) checkTide(c);
     }    
   
   for(auto& t: tempmonsters) t.first->monst = t.second;
+
+  for(cell *c: dcal) if(c->monst) {
+    if(c->monst >= isize(dcal_by_monster)) dcal_by_monster.resize(c->monst + 1);
+    dcal_by_monster[c->monst].push_back(c);
+    }
   
   buildAirmap();
   }
@@ -22,12 +22,20 @@ void canonicize(vector<int>& t) {
   }
 
 #if HDR
+struct intvector_hash {
+  size_t operator() (const vector<int>& v) const {
+    size_t res = v.size();
+    for(int x: v) res ^= size_t(x) + 0x9e3779b9 + (res << 6) + (res >> 2);
+    return res;
+    }
+  };
+
 struct expansion_analyzer {
   int sibling_limit;
   vector<int> gettype(cell *c);
   int N;
   vector<cell*> samples;  
-  map<vector<int>, int> codeid;  
+  std::unordered_map<vector<int>, int, intvector_hash> codeid;  
   vector<vector<int> > children;  
   int rootid, diskid;
   int coefficients_known;
@@ -46,7 +54,10 @@ struct expansion_analyzer {
   bignum& get_descendants(int level);
   bignum& get_descendants(int level, int type);
   void find_coefficients();
+  bool find_coefficients_bm();
+  bool find_coefficients_gauss();
   void reset();
+  vector<long long> descendants_mod(int levels, long long p);
   
   expansion_analyzer() { reset(); }
 
@@ -57,6 +68,9 @@ struct expansion_analyzer {
   private:
   bool verify(int id);
   int valid(int v, int step);
+  bool verify_range(int v, int step, int more);
+  bool load_coefficients();
+  void save_coefficients();
   };
 #endif
 
@@ -75,12 +89,9 @@ vector<int> expansion_analyzer::gettype(cell *c) {
   }
 
 int expansion_analyzer::sample_id(cell *c) {
-  auto t = gettype(c);
-  if(codeid.count(t)) return codeid[t];
-  auto &cit = codeid[t];
-  cit = isize(samples);
-  samples.push_back(c);
-  return cit;
+  auto ins = codeid.emplace(gettype(c), isize(samples));
+  if(ins.second) samples.push_back(c);
+  return ins.first->second;
   }
 
 template<class T, class U> vector<int> get_children_codes(cell *c, const T& distfun, const U& typefun) {
@@ -213,6 +224,8 @@ bignum& expansion_analyzer::get_descendants(int level) {
 bignum& expansion_analyzer::get_descendants(int level, int type) {
   if(!N) preliminary_grouping(), reduce_grouping();
   auto& pd = descendants;
+  /* levels are filled in order, so a complete level means that it is already memoized */
+  if(level < isize(pd) && isize(pd[level]) == N) return pd[level][type];
   size_upto(pd, level+1);
   for(int d=0; d<=level; d++)
   for(int i=size_upto(pd[d], N); i<N; i++)
@@ -295,29 +308,174 @@ int expansion_analyzer::valid(int v, int step) {
   for(int i=0; i<v; i++) coef[i] = int(floor(matrix[v-1-i][v] + .5));
   #endif
     
-  for(int t=step+v; t<step+v+v+more; t++) if(!verify(t)) return 2;
+  return verify_range(v, step, more) ? 3 : 2;
+  }
+
+/** check whether the recurrence given by coef holds from step+v on; if yes, set valid_from and tested_to */
+bool expansion_analyzer::verify_range(int v, int step, int more) {
+  for(int t=step+v; t<step+v+v+more; t++) if(!verify(t)) return false;
   tested_to = step+v+v+more;
   while(tested_to < step+v+v+100) {
     #if !CAP_GMP
     if(get_descendants(tested_to).approx_ll() >= bignum::BASE2) break;
     #endif
-    if(!verify(tested_to)) return 2;
+    if(!verify(tested_to)) return false;
     tested_to++;
     }
   
   valid_from = step+v;
-  return 3;
+  return true;
   }
 
-void expansion_analyzer::find_coefficients() {
-  if(coefficients_known) return;
-  if(!N) preliminary_grouping(), reduce_grouping();
+/** descendants of rootid on levels 0..levels-1, modulo p */
+vector<long long> expansion_analyzer::descendants_mod(int levels, long long p) {
+  vector<long long> res, cur(N, 1), nxt(N);
+  for(int d=0; d<levels; d++) {
+    res.push_back(cur[rootid]);
+    for(int i=0; i<N; i++) {
+      long long sum = 0;
+      for(int j: children[i]) sum += cur[j];
+      nxt[i] = sum % p;
+      }
+    swap(cur, nxt);
+    }
+  return res;
+  }
+
+/** the shortest linear recurrence for s[0..n-1] modulo prime p, via the Berlekamp-Massey algorithm;
+ *  returns c such that s[i] = sum_j c[j] * s[i-j-1] */
+static vector<long long> berlekamp_massey(const long long *s, int n, long long p) {
+  auto inverse = [p] (long long a) {
+    long long res = 1, e = p - 2;
+    for(; e; e >>= 1, a = a * a % p) if(e & 1) res = res * a % p;
+    return res;
+    };
+  vector<long long> C(n+1, 0), B(n+1, 0), T;
+  C[0] = B[0] = 1;
+  int L = 0, m = 0;
+  long long b = 1;
+  for(int i=0; i<n; i++) {
+    m++;
+    long long d = s[i] % p;
+    for(int j=1; j<=L; j++) d = (d + C[j] * s[i-j]) % p;
+    if(!d) continue;
+    T = C;
+    long long coef = d * inverse(b) % p;
+    for(int j=m; j<=n; j++) C[j] = ((C[j] - coef * B[j-m]) % p + p) % p;
+    if(2 * L > i) continue;
+    L = i + 1 - L; B = T; b = d; m = 0;
+    }
+  vector<long long> res(L);
+  for(int j=0; j<L; j++) res[j] = (p - C[j+1]) % p;
+  return res;
+  }
+
+/** find num/den congruent to r modulo p, with |num|, den <= sqrt(p/2) */
+static bool rational_reconstruction(long long r, long long p, long long& num, long long& den) {
+  long long bound = (long long) sqrt(p / 2.);
+  long long r0 = p, r1 = r, t0 = 0, t1 = 1;
+  while(r1 > bound) {
+    long long q = r0 / r1;
+    r0 -= q * r1; swap(r0, r1);
+    t0 -= q * t1; swap(t0, t1);
+    }
+  if(t1 == 0 || t1 > bound || t1 < -bound) return false;
+  num = t1 < 0 ? -r1 : r1; den = t1 < 0 ? -t1 : t1;
+  return true;
+  }
+
+/** a fast path for find_coefficients: the candidate recurrences are computed modulo a prime
+ *  using Berlekamp-Massey rather than by Gaussian elimination, and then verified exactly */
+bool expansion_analyzer::find_coefficients_bm() {
+  const long long p = 2147483647;
+  const int maxv = 24;
+  int more = reg3::exact_rules() ? 1 : 5;
+  int window = 2 * maxv + more;
+  auto seq = descendants_mod(3 * maxv + window, p);
+  vector<vector<long long>> rec(3 * maxv);
+  vector<bool> known(3 * maxv, false);
+  for(int v=1; v<=maxv; v++)
+  for(int step=0; step<3 * v; step++) {
+    if(!known[step]) rec[step] = berlekamp_massey(&seq[step], window, p), known[step] = true;
+    if(isize(rec[step]) != v) continue;
+    #if CAP_GMP == 0
+    if(get_descendants(step+v+v+more).approx_int() >= bignum::BASE) break;
+    #endif
+    coef.resize(v);
+    bool ok = true;
+    for(int i=0; i<v && ok; i++) {
+      long long num, den;
+      ok = rational_reconstruction(rec[step][i], p, num, den);
+      #if CAP_GMP
+      if(ok) { coef[i] = mpq_class(its(num) + "/" + its(den)); coef[i].canonicalize(); }
+      #else
+      if(ok && den != 1) ok = false;
+      if(ok) coef[i] = int(num);
+      #endif
+      }
+    if(ok && verify_range(v, step, more)) return true;
+    }
+  coef.clear();
+  return false;
+  }
+
+/** file to cache the results of find_coefficients in; empty if not used */
+EX string expansion_cache_file;
+
+/** the cache key, or empty if the current tiling is not identified by cgi_string across runs */
+string expansion_cache_key() {
+  if(arb::in() || IRREGULAR || currentmap->strict_tree_rules()) return "";
+  return "expansion " + cgi_string();
+  }
+
+bool expansion_analyzer::load_coefficients() {
+  string key = expansion_cache_key();
+  if(key == "") return false;
+  return cache_lookup(expansion_cache_file, key, [this] (const string& data) {
+    std::stringstream ss(data);
+    int known, from, to, v;
+    if(!(ss >> known >> from >> to >> v) || known != 2 || v < 0) return false;
+    decltype(coef) res(v);
+    for(auto& c: res) {
+      string cs;
+      if(!(ss >> cs)) return false;
+      #if CAP_GMP
+      c = mpq_class(cs);
+      #else
+      c = atoi(cs.c_str());
+      #endif
+      }
+    coef = res; valid_from = from; tested_to = to; coefficients_known = known;
+    return true;
+    });
+  }
+
+void expansion_analyzer::save_coefficients() {
+  string key = expansion_cache_key();
+  if(key == "") return;
+  shstream data;
+  print(data, coefficients_known, " ", valid_from, " ", tested_to, " ", isize(coef));
+  for(auto& c: coef) print(data, " ", c);
+  cache_append(expansion_cache_file, key, data.s);
+  }
+
+/** the original path of find_coefficients: try every recurrence length and starting step, solving for the coefficients by Gaussian elimination */
+bool expansion_analyzer::find_coefficients_gauss() {
   for(int v=1; v<25; v++) 
   for(int step=0; step<3 * v; step++) { 
     int val = valid(v, step);
     if(val == 0) break;
-    if(val == 3) { coefficients_known = 2; return; }
+    if(val == 3) return true;
     }
+  return false;
+  }
+
+/** failures are not cached, since they may depend on the precision available */
+void expansion_analyzer::find_coefficients() {
+  if(coefficients_known) return;
+  if(load_coefficients()) return;
+  if(!N) preliminary_grouping(), reduce_grouping();
+  if(find_coefficients_bm() || find_coefficients_gauss()) { coefficients_known = 2; save_coefficients(); return; }
   coefficients_known = 1;
   }
 
@@ -365,9 +523,9 @@ EX int type_in(expansion_analyzer& ea, cell *c, const cellfunction& f) {
     }
   
   canonicize(res);
-  if(ea.codeid.count(res)) return ea.codeid[res];
+  auto ins = ea.codeid.emplace(res, ea.N);
+  if(!ins.second) return ins.first->second;
   int ret = ea.N++;
-  ea.codeid[res] = ret;
   
   ea.children.emplace_back();
   ea.children[ret] = get_children_codes(c, f, [&ea, &f] (cell *c1) { return type_in(ea, c1, f); });
@@ -387,7 +545,8 @@ int type_in_quick(expansion_analyzer& ea, cell *c, const cellfunction& f) {
     }
   
   canonicize(res);
-  if(ea.codeid.count(res)) return ea.codeid[res];
+  auto it = ea.codeid.find(res);
+  if(it != ea.codeid.end()) return it->second;
   return -1;
   }
 
@@ -734,12 +893,12 @@ void expansion_analyzer::view_distances_dialog() {
     }
   else {
     if(distance_from == dfPlayer) {
-      celllister cl(cwt.at, closed_manifold ? maxlen-1 : gamerange(), 100000, NULL);
+      cellbfs cl(cwt.at, closed_manifold ? maxlen-1 : gamerange(), 100000, NULL);
       for(int d: cl.dists)
         if(d >= 0 && d < maxlen) qty[d]++;
       }
     else {
-      celllister cl(cwt.at, closed_manifold ? maxlen-1 : gamerange(), 100000, NULL);
+      cellbfs cl(cwt.at, closed_manifold ? maxlen-1 : gamerange(), 100000, NULL);
       for(cell *c: cl.lst) if((not_only_descendants || is_descendant(c)) && curr_dist(c) < maxlen) qty[curr_dist(c)]++;
       }
     #if !CAP_GMP
@@ -946,6 +1105,10 @@ int expansion_readArgs() {
     shift(); dist_label_color = argcolor(24);
     }
 
+  else if(argis("-expansion-cache")) {
+    shift(); expansion_cache_file = args();
+    }
+
   else if(argis("-expansion-off")) {
     viewdists = false;
     }
@@ -1005,6 +1168,112 @@ int sibling_distance(cell *a, cell *b, int limit) {
     }
   }
 
+/** maximum number of cell pairs remembered by the celldistance cache, and of cells with remembered skip pointers (at least 256) */
+EX int celldistance_cache_size = 65536;
+
+/** skip pointers for hyperbolic_celldistance: jumps[side][k] is the (2^k)-th left (side 0) or right (side 1) ancestor */
+struct ancestor_jumps {
+  vector<cell*> jumps[2];
+  };
+
+/** two generations, like distance_cache: recently used cells are in ancestor_table[0]; when it fills up, it replaces ancestor_table[1] */
+std::unordered_map<cell*, ancestor_jumps> ancestor_table[2];
+
+/** the skip pointers of c, moved to the recent generation; the reference is valid until the next call */
+ancestor_jumps& get_ancestor_jumps(cell *c) {
+  auto it = ancestor_table[0].find(c);
+  if(it != ancestor_table[0].end()) return it->second;
+  ancestor_jumps aj;
+  it = ancestor_table[1].find(c);
+  if(it != ancestor_table[1].end()) aj = std::move(it->second);
+  if(2 * isize(ancestor_table[0]) >= max(celldistance_cache_size, 256)) {
+    swap(ancestor_table[0], ancestor_table[1]);
+    ancestor_table[0].clear();
+    }
+  return ancestor_table[0][c] = std::move(aj);
+  }
+
+/** the (2^k)-th left (side 0) or right (side 1) ancestor of c wrt celldist0, or NULL if there is none; computed lazily */
+cell *ancestor_jump(cell *c, int side, int k) {
+  auto& known = get_ancestor_jumps(c).jumps[side];
+  if(k < isize(known)) return known[k];
+  /* the recursive calls may move or drop the entry of c, so it is looked up again */
+  vector<cell*> v = known;
+  while(isize(v) <= k) {
+    int j = isize(v);
+    cell *a;
+    if(j == 0) a = side ? ts::right_parent(c, celldist0) : ts::left_parent(c, celldist0);
+    else {
+      a = v[j-1];
+      if(a) a = ancestor_jump(a, side, j-1);
+      }
+    v.push_back(a);
+    }
+  get_ancestor_jumps(c).jumps[side] = v;
+  return v[k];
+  }
+
+/** the ancestor of c, steps levels up */
+cell *ancestor(cell *c, int side, int steps) {
+  for(int k=0; steps && c; k++, steps >>= 1)
+    if(steps & 1) c = ancestor_jump(c, side, k);
+  return c;
+  }
+
+/** segments [l1,r1] and [l2,r2] at the same level are far enough to not yield the distance; then the same is true at all the lower levels */
+bool segments_far(cell *l1, cell *r1, cell *l2, cell *r2, int limit) {
+  if(in_segment(l1, l2, r1) || in_segment(l2, l1, r2)) return false;
+  return sibling_distance(r1, l2, limit) == INF && sibling_distance(r2, l1, limit) == INF;
+  }
+
+struct cellpair_hash {
+  size_t operator() (const pair<cell*, cell*>& p) const { return std::hash<cell*>()(p.first) ^ (std::hash<cell*>()(p.second) * 0x9E3779B9); }
+  };
+
+typedef std::unordered_map<pair<cell*, cell*>, int, cellpair_hash> distance_table;
+
+/** approximate LRU: recently used pairs are in distance_cache[0]; when it fills up, it replaces distance_cache[1] */
+distance_table distance_cache[2];
+
+auto clear_distance_caches = addHook(hooks_clearmemory, 0, [] {
+  ancestor_table[0].clear(); ancestor_table[1].clear(); distance_cache[0].clear(); distance_cache[1].clear();
+  }) + addHook(hooks_removecells, 0, [] {
+  ancestor_table[0].clear(); ancestor_table[1].clear(); distance_cache[0].clear(); distance_cache[1].clear();
+  });
+
+int hyperbolic_celldistance_uncached(cell *c1, cell *c2);
+
+/** the distances cached so far may have been computed with a too small limit */
+void grow_sibling_limit(int& sibling_limit) {
+  printf("sibling_limit used: %d\n", sibling_limit); sibling_limit++;
+  distance_cache[0].clear(); distance_cache[1].clear();
+  }
+
+/** use the ancestor skip pointers in hyperbolic_celldistance; if false, every level is walked (used for testing) */
+EX bool celldistance_skip_levels = true;
+
+/** hyperbolic_celldistance with the results cached
+ *  Main thread only: the caches, the skip pointers and sibling_limit are global, and the cells on the way may be created.
+ */
+EX int hyperbolic_celldistance(cell *c1, cell *c2) {
+  if(c1 == c2) return 0;
+  if(!in_main_thread()) throw hr_exception("hyperbolic_celldistance called outside of the main thread");
+  if(celldistance_cache_size <= 0) return hyperbolic_celldistance_uncached(c1, c2);
+  auto key = c1 < c2 ? make_pair(c1, c2) : make_pair(c2, c1);
+  auto it = distance_cache[0].find(key);
+  if(it != distance_cache[0].end()) return it->second;
+  int d;
+  it = distance_cache[1].find(key);
+  if(it != distance_cache[1].end()) d = it->second;
+  else d = hyperbolic_celldistance_uncached(c1, c2);
+  if(2 * isize(distance_cache[0]) >= celldistance_cache_size) {
+    swap(distance_cache[0], distance_cache[1]);
+    distance_cache[0].clear();
+    }
+  distance_cache[0][key] = d;
+  return d;
+  }
+
 /** An algorithm for computing distance between two cells.
     This algorithm runs correctly in O(d) assuming that:
     - distances from the origin are known
@@ -1012,14 +1281,40 @@ int sibling_distance(cell *a, cell *b, int limit) {
     - the map is Gromov hyperbolic (with sibling_limit computed correctly) and planar
     - all vertices have valence <= 4
     - each vertex has at most two parents
+    Ancestor skip pointers are used to skip the levels where nothing can be found, so it usually runs in O(log(d)^2).
     */
-EX int hyperbolic_celldistance(cell *c1, cell *c2) {
+int hyperbolic_celldistance_uncached(cell *c1, cell *c2) {
   int found_distance = INF;
   
   int d = 0, d1 = celldist0(c1), d2 = celldist0(c2), sl_used = 0;
   auto& sibling_limit = get_expansion().sibling_limit;
 
   cell *cl1=c1, *cr1=c1, *cl2=c2, *cr2=c2;
+
+  bool skip = celldistance_skip_levels && !(a45 && BITRUNCATED);
+  if(skip && d1 > d2) {
+    int k = d1 - d2;
+    cl1 = ancestor(c1, 0, k); cr1 = ancestor(c1, 1, k);
+    d += k; d1 -= k;
+    }
+  if(skip && d2 > d1) {
+    int k = d2 - d1;
+    cl2 = ancestor(c2, 0, k); cr2 = ancestor(c2, 1, k);
+    d += k; d2 -= k;
+    }
+  if(skip && d1 == d2 && cl1 && cl2) {
+    int limit = 2 * sibling_limit + 2;
+    int k = 0;
+    while((2<<k) < d1) k++;
+    for(; k>=0; k--) if((1<<k) < d1) {
+      cell *l1 = ancestor_jump(cl1, 0, k), *r1 = ancestor_jump(cr1, 1, k);
+      cell *l2 = ancestor_jump(cl2, 0, k), *r2 = ancestor_jump(cr2, 1, k);
+      if(!l1 || !r1 || !l2 || !r2 || !segments_far(l1, r1, l2, r2, limit)) continue;
+      cl1 = l1; cr1 = r1; cl2 = l2; cr2 = r2;
+      d += 2<<k; d1 -= 1<<k; d2 -= 1<<k;
+      }
+    }
+
   while(true) {
   
     if(a45 && BITRUNCATED) {
@@ -1029,7 +1324,7 @@ EX int hyperbolic_celldistance(cell *c1, cell *c2) {
         swap(d1, d2); swap(cl1, cl2); swap(c1, c2); swap(cr1, cr2);
         }
       auto short_distances = [cl1, cr1, d, &found_distance] (cell *c) {
-        celllister cl(c, 4, 1000, cl1);
+        cellbfs cl(c, 4, 1000, cl1);
         if(cl.listed(cl1)) found_distance = min(found_distance, d + cl.getdist(cl1));
         if(cl.listed(cr1)) found_distance = min(found_distance, d + cl.getdist(cr1));
         };
@@ -1041,9 +1336,7 @@ EX int hyperbolic_celldistance(cell *c1, cell *c2) {
       }
     
     if(d >= found_distance) {
-      if(sl_used == sibling_limit && IRREGULAR) { 
-        printf("sibling_limit used: %d\n", sibling_limit); sibling_limit++;
-        }
+      if(sl_used == sibling_limit && IRREGULAR) grow_sibling_limit(sibling_limit);
       return found_distance;
       }
 
@@ -1063,9 +1356,7 @@ EX int hyperbolic_celldistance(cell *c1, cell *c2) {
       }    
     
     if(d >= found_distance) {
-      if(sl_used == sibling_limit && IRREGULAR) { 
-        printf("sibling_limit used: %d\n", sibling_limit); sibling_limit++; 
-        }
+      if(sl_used == sibling_limit && IRREGULAR) grow_sibling_limit(sibling_limit);
       return found_distance;
       }
 
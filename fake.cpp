@@ -44,6 +44,32 @@ EX namespace fake {
   
   map<cell*, ld> random_order;
 
+  /** key of the adj cache in the coxeter variation: the shapes and faces on both sides, and the underlying matrix */
+  struct coxeter_adj_key {
+    int s1, d, s2, sp;
+    transmatrix T;
+    bool operator == (const coxeter_adj_key& k) const {
+      if(s1 != k.s1 || d != k.d || s2 != k.s2 || sp != k.sp) return false;
+      for(int i=0; i<MAXMDIM; i++) for(int j=0; j<MAXMDIM; j++) if(T[i][j] != k.T[i][j]) return false;
+      return true;
+      }
+    };
+
+  struct coxeter_adj_hash {
+    size_t operator() (const coxeter_adj_key& k) const {
+      size_t h = k.s1;
+      for(int v: {k.d, k.s2, k.sp}) h = h * 1000003 + v;
+      for(int i=0; i<MAXMDIM; i++) for(int j=0; j<MAXMDIM; j++) h = h * 1000003 ^ std::hash<ld>()(k.T[i][j]);
+      return h;
+      }
+    };
+
+  /** cells with the same local configuration in the underlying map get the same adj, so it is computed once */
+  EX bool cache_adj = true;
+  std::unordered_map<coxeter_adj_key, transmatrix, coxeter_adj_hash> coxeter_adj_cache;
+
+  EX void clear_adj_cache() { coxeter_adj_cache.clear(); }
+
   // a dummy map that does nothing
   struct hrmap_fake : hrmap {
     hrmap *underlying_map;
@@ -78,6 +104,7 @@ EX namespace fake {
       }
     
     ~hrmap_fake() { 
+      clear_adj_cache();
       in_underlying([this] {
         delete underlying_map; 
         });
@@ -100,9 +127,20 @@ EX namespace fake {
 
     transmatrix adj(cell *c, int d) override {
       if(variation == eVariation::coxeter) {
+        coxeter_adj_key key;
+        key.d = d; key.sp = c->c.spin(d);
+        in_underlying([&key, c, d] {
+          key.T = currentmap->adj(c, d);
+          key.s1 = currentmap->shvid(c);
+          key.s2 = currentmap->shvid(c->move(d));
+          });
+        if(cache_adj) {
+          auto it = coxeter_adj_cache.find(key);
+          if(it != coxeter_adj_cache.end()) return it->second;
+          }
         array<int, 3> which;
-        in_underlying([&which, c, d] {
-          auto T = currentmap->adj(c, d);
+        in_underlying([&which, &key, c, d] {
+          auto& T = key.T;
           auto& f1 = currentmap->get_cellshape(c).faces_local[d];
           auto& f2 = currentmap->get_cellshape(c->move(d)).faces_local[c->c.spin(d)];
           for(int i=0; i<3; i++) {
@@ -133,6 +171,10 @@ EX namespace fake {
         set_column(F2, 3, dtang(cf2));
         set_column(F1, 3, dtang(f1));
         transmatrix T = F1 * inverse(F2);
+        if(cache_adj) {
+          if(isize(coxeter_adj_cache) >= 1<<16) coxeter_adj_cache.clear();
+          coxeter_adj_cache[key] = T;
+          }
         return T;
         }
       transmatrix S1, S2;
@@ -573,6 +615,9 @@ EX geometryinfo1 geometry_of_curvature(ld curvature, int dim) {
 
 EX void compute_scale() {
 
+  /* also called by change_around */
+  clear_adj_cache();
+
   ld good = compute_euclidean();
   
   if(around < 0) around = good;
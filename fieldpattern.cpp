@@ -271,6 +271,10 @@ struct fpattern {
   int solve();
   
   void build();
+
+  string tables_key();
+  bool load_tables();
+  void save_tables();
   
   static const int MAXDIST = 120;
   
@@ -858,25 +862,28 @@ void fpattern::build() {
     printf("Solved %s as matrix of order %d\n", qpaths[i].c_str(), order(M));
     }
   
-  matcode.clear(); matrices.clear();
-  add(Id);
-  if(isize(matrices) != local_group) { printf("Error: rotation crash #1 (%d)\n", isize(matrices)); exit(1); }
+  if(!load_tables()) {
+    matcode.clear(); matrices.clear();
+    add(Id);
+    if(isize(matrices) != local_group) { printf("Error: rotation crash #1 (%d)\n", isize(matrices)); exit(1); }
   
-  connections.clear();
+    connections.clear();
   
-  for(int i=0; i<(int)matrices.size(); i++) {
+    for(int i=0; i<(int)matrices.size(); i++) {
   
-    matrix M = matrices[i];
+      matrix M = matrices[i];
     
-    matrix PM = mmul(P, M);
+      matrix PM = mmul(P, M);
     
-    add(PM);
+      add(PM);
 
-    if(isize(matrices) % local_group) { printf("Error: rotation crash (%d)\n", isize(matrices)); exit(1); }
+      if(isize(matrices) % local_group) { printf("Error: rotation crash (%d)\n", isize(matrices)); exit(1); }
     
-    if(!matcode.count(PM)) { printf("Error: not marked\n"); exit(1); }
+      if(!matcode.count(PM)) { printf("Error: not marked\n"); exit(1); }
 
-    connections.push_back(matcode[PM]);
+      connections.push_back(matcode[PM]);
+      }
+    save_tables();
     }
 
   DEBB(DF_FIELD, ("Computing inverses...\n"));
@@ -928,6 +935,57 @@ void fpattern::build() {
   DEBB(DF_FIELD, ("Built.\n"));
   }
 
+/** file to cache the matrices and connections computed by fpattern::build in; empty if not used */
+EX string fieldpattern_cache_file;
+
+/** the tables depend only on the field, the number of rotations, and the generators R and P */
+string fpattern::tables_key() {
+  if(fieldpattern_cache_file == "" || WDIM != 2 || isize(qpaths)) return "";
+  shstream ss;
+  print(ss, "fieldpattern ", ginf[geometry].tiling_name, " p=", Prime, " sq=", wsquare, " lg=", local_group);
+  for(auto& M: {R, P}) for(int i=0; i<MWDIM; i++) for(int j=0; j<MWDIM; j++) print(ss, " ", M[i][j]);
+  return ss.s;
+  }
+
+bool fpattern::load_tables() {
+  string key = tables_key();
+  if(key == "") return false;
+  return cache_lookup(fieldpattern_cache_file, key, [this] (const string& data) {
+    std::stringstream ss(data);
+    int N;
+    if(!(ss >> N) || N <= 0 || N % local_group) return false;
+    vector<matrix> mats(N, Id);
+    for(auto& M: mats) for(int i=0; i<MWDIM; i++) for(int j=0; j<MWDIM; j++)
+      if(!(ss >> M[i][j]) || M[i][j] <= -Prime || M[i][j] >= Prime) return false;
+    vector<int> con(N);
+    for(int& c: con) if(!(ss >> c) || c < 0 || c >= N) return false;
+    if(mats[0] != Id) return false;
+    map<matrix, int> codes;
+    for(int i=0; i<N; i++) codes[mats[i]] = i;
+    if(isize(codes) != N) return false;
+    /* build() relies on R rotating within each group of local_group matrices, and on connections being the P-neighbors */
+    for(int i=0; i<N; i++) {
+      auto it = codes.find(mmul(R, mats[i]));
+      if(it == codes.end() || it->second != groupspin(i, 1, local_group)) return false;
+      it = codes.find(mmul(P, mats[i]));
+      if(it == codes.end() || it->second != con[i]) return false;
+      }
+    matrices = std::move(mats); matcode = std::move(codes); connections = std::move(con);
+    DEBB(DF_FIELD, ("loaded ", N, " matrices from the cache"));
+    return true;
+    });
+  }
+
+void fpattern::save_tables() {
+  string key = tables_key();
+  if(key == "") return;
+  shstream data;
+  print(data, isize(matrices));
+  for(auto& M: matrices) for(int i=0; i<MWDIM; i++) for(int j=0; j<MWDIM; j++) print(data, " ", M[i][j]);
+  for(int c: connections) print(data, " ", c);
+  cache_append(fieldpattern_cache_file, key, data.s);
+  }
+
 int fpattern::getdist(pair<int,bool> a, vector<char>& dists) {
   if(!a.second) return dists[a.first];
   int m = MAXDIST;
@@ -1084,20 +1142,18 @@ void fpattern::analyze() {
   int rpushid = matcode[PRRPRRRRR];
   riverid = 0;
   
+  /* i is the river if rpush * i == i * Wall^k for some k, i.e., if i^-1 * rpush * i is a power of Wall */
+  map<int, int> wallpowers;
+  for(int k=0, j=0; k<wallorder; k++, j = gmul(j, wallid)) wallpowers.emplace(j, k);
+
   for(int i=0; i<N; i++) {
-    int j = i;
-    int ipush = gmul(rpushid, i);
-    for(int k=0; k<wallorder; k++) {
-      if(ipush == j) {
-        DEBB(DF_FIELD, ("River found at %d:%d\n", i, k));
-        riverid = i;
-        goto riveridfound;
-        }
-      j = gmul(j, wallid);
+    auto it = wallpowers.find(gmul(inverses[i], gmul(rpushid, i)));
+    if(it != wallpowers.end()) {
+      DEBB(DF_FIELD, ("River found at %d:%d\n", i, it->second));
+      riverid = i;
+      break;
       }
     }
-  
-  riveridfound: ;
 
   W = strtomatrix("RRRRPR");
   for(int j=0; j<wallorder; j++) {
@@ -1579,6 +1635,7 @@ int hk =
       else if(argis("-q3-limitsq")) { shift(); limitsq = argi(); }
       else if(argis("-q3-limitp")) { shift(); limitp = argi(); }
       else if(argis("-q3-limitv")) { shift(); limitv = argi(); }
+      else if(argis("-fieldpattern-cache")) { shift(); fieldpattern_cache_file = args(); }
       else return 1;
       return 0;
       })
@@ -945,10 +945,41 @@ void geometry_information::generate_floorshapes() {
     }
   }
 
+/** \brief per-cell cache of the floor shape data which would be otherwise recomputed in every frame
+ *
+ *  Only valid for shape_cache_for; also cleared when the memory is cleared, cells are removed, or the plain shapes are reset.
+ */
+struct shape_cache_entry {
+  int plainshape_id;
+  bool coloring_known;
+  patterns::patterninfo coloring;
+  };
+
+std::unordered_map<cell*, shape_cache_entry> shape_cache;
+geometry_information *shape_cache_for;
+
+EX void clear_shape_cache() {
+  shape_cache.clear();
+  }
+
+shape_cache_entry& get_shape_cache(cell *c) {
+  if(shape_cache_for != &cgi) shape_cache.clear(), shape_cache_for = &cgi;
+  auto it = shape_cache.find(c);
+  if(it != shape_cache.end()) return it->second;
+  auto& e = shape_cache[c];
+  e.plainshape_id = -1;
+  e.coloring_known = false;
+  return e;
+  }
+
+auto shape_cache_hook = addHook(hooks_clearmemory, 0, clear_shape_cache)
+  + addHook(hooks_removecells, 0, [] { for(cell *c: removed_cells) shape_cache.erase(c); });
+
 #if CAP_GP
 EX namespace gp {
   
   EX void clear_plainshapes() {
+    clear_shape_cache();
     for(int m=0; m<3; m++)
     for(int sd=0; sd<8; sd++)
     for(int i=0; i<GOLDBERG_LIMIT; i++)
@@ -974,6 +1005,8 @@ EX namespace gp {
     }
   
   EX int get_plainshape_id(cell *c) {
+    auto& sc = get_shape_cache(c);
+    if(sc.plainshape_id != -1) return sc.plainshape_id;
     if(li_for != c) {
       li_for = c;
       current_li = get_local_info(c);
@@ -1016,6 +1049,7 @@ EX namespace gp {
       forCellEx(c1, c) if(!gmatrix0.count(c1)) return 0;
       }
     if(id == -1) build_plainshape(id, current_li, c, siid, sidir);
+    sc.plainshape_id = id;
     return id;
     }
   EX }
@@ -1130,7 +1164,9 @@ EX struct dqi_poly *draw_shapevec(cell *c, const shiftmatrix& V, const vector<hp
   else if(GOLDBERG && ishex1(c)) 
     return &queuepolyat(V * pispin, shv[0], col, prio);
   else if(!(S7&1) && PURE && !kite::in() && !a4) {
-    auto si = patterns::getpatterninfo(c, patterns::PAT_COLORING, 0);
+    auto& sc = get_shape_cache(c);
+    if(!sc.coloring_known) sc.coloring = patterns::getpatterninfo(c, patterns::PAT_COLORING, 0), sc.coloring_known = true;
+    auto si = sc.coloring;
     if(si.id == 8) si.dir++;
     transmatrix D = applyPatterndir(c, si);
     return &queuepolyat(V*D, shv[shvid(c)], col, prio);
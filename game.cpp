@@ -18,13 +18,172 @@ namespace hr {
  */
 EX std::mt19937 hrngen;
 
+/** \brief counter-based random numbers for order-independent land generation
+ *
+ *  If cell_rng_mode is on, the random decisions made while generating a cell (in setdist) are taken
+ *  from a Philox-4x32-10 stream keyed by the seed, a stable address of the cell, and a purpose tag
+ *  (the generation level), rather than from hrngen. They do not depend on the order of generation then.
+ *  Cells without a stable address (see cell_address) still use hrngen.
+ *
+ *  This is used only in the single land structure (ls::single). In the other land structures, the generation
+ *  of a cell also places the land boundaries (e.g., great walls) through cells far away, so the result
+ *  depends on the order of generation anyway; cell_rng_mode is ignored there.
+ */
+EX bool cell_rng_mode = false;
+
+/** \brief the key for cell_rng; set by shrand */
+EX unsigned cell_rng_seed;
+
+#if HDR
+struct cell_rng {
+  /** address (low and high bits), purpose, block number */
+  array<unsigned, 4> ctr;
+  array<unsigned, 4> out;
+  int used;
+  cell_rng(unsigned long long address, unsigned purpose) {
+    ctr[0] = unsigned(address); ctr[1] = unsigned(address >> 32); ctr[2] = purpose; ctr[3] = 0;
+    used = 4;
+    }
+  unsigned next();
+  };
+
+/** \brief while this object exists, hrand draws from the cell_rng stream of (c, purpose) -- if cell_rng_mode is on */
+struct cell_rng_scope {
+  cell_rng rng;
+  cell_rng *saved;
+  bool active;
+  cell_rng_scope(cell *c, unsigned purpose);
+  ~cell_rng_scope();
+  };
+#endif
+
+unsigned cell_rng::next() {
+  if(used == 4) {
+    unsigned x0 = ctr[0], x1 = ctr[1], x2 = ctr[2], x3 = ctr[3];
+    unsigned k0 = cell_rng_seed, k1 = 0x5EED1234;
+    for(int r=0; r<10; r++) {
+      unsigned long long p0 = 0xD2511F53ull * x0, p1 = 0xCD9E8D57ull * x2;
+      unsigned y0 = unsigned(p1 >> 32) ^ x1 ^ k0, y2 = unsigned(p0 >> 32) ^ x3 ^ k1;
+      x0 = y0; x1 = unsigned(p1); x2 = y2; x3 = unsigned(p0);
+      k0 += 0x9E3779B9; k1 += 0xBB67AE85;
+      }
+    out[0] = x0; out[1] = x1; out[2] = x2; out[3] = x3;
+    used = 0; ctr[3]++;
+    }
+  return out[used++];
+  }
+
+/** \brief the stream used instead of hrngen, if any; each thread generating cells has its own */
+thread_local cell_rng *active_cell_rng;
+
+static unsigned long long address_mix(unsigned long long a, unsigned long long b) {
+  a ^= b + 0x9E3779B97F4A7C15ull + (a << 6) + (a >> 2);
+  a ^= a >> 31; a *= 0xBF58476D1CE4E5B9ull; a ^= a >> 29;
+  return a;
+  }
+
+/** memo for heptagon_address; cells may be generated in several threads, so it is guarded by heptagon_addresses_lock */
+map<heptagon*, unsigned long long> heptagon_addresses;
+#if CAP_THREAD
+std::mutex heptagon_addresses_lock;
+#endif
+
+/** the address of a heptagon in a standard hyperbolic tiling, based on its path from the origin in the heptagon tree */
+static unsigned long long heptagon_address(heptagon *h) {
+  #if CAP_THREAD
+  std::unique_lock<std::mutex> lk(heptagon_addresses_lock);
+  #endif
+  vector<heptagon*> path;
+  unsigned long long a = 0;
+  while(true) {
+    auto p = heptagon_addresses.find(h);
+    if(p != heptagon_addresses.end()) { a = p->second; break; }
+    if(h->s == hsOrigin || !h->move(0)) { a = address_mix(0x0519, h->s); heptagon_addresses[h] = a; break; }
+    path.push_back(h);
+    h = h->move(0);
+    }
+  while(!path.empty()) {
+    h = path.back(); path.pop_back();
+    a = address_mix(a, h->c.spin(0));
+    heptagon_addresses[h] = a;
+    }
+  return a;
+  }
+
+/** \brief compute an address of c which does not depend on the order in which cells were created
+ *  This does not create any cells or heptagons, so it can be called while cells are generated in other threads.
+ *  @return false if not supported in the current geometry
+ */
+EX bool cell_address(cell *c, unsigned long long& addr) {
+  if(euc::in() && c == c->master->c7) {
+    auto& ispacemap = euc::get_ispacemap();
+    auto it = ispacemap.find(c->master);
+    if(it == ispacemap.end()) return false;
+    auto& co = it->second;
+    addr = address_mix(address_mix(address_mix(0xE0C1, co[0]), co[1]), co[2]);
+    return true;
+    }
+  if(!hyperbolic || quotient || WDIM != 2 || !standard_tiling() || !dynamic_cast<hrmap_hyperbolic*>(currentmap))
+    return false;
+  if(c == c->master->c7) {
+    addr = heptagon_address(c->master);
+    return true;
+    }
+  if(!BITRUNCATED) return false;
+  /* a hexagon is identified by the three adjacent heptagons */
+  /* the three heptagons are linked when the hexagon is created */
+  vector<unsigned long long> adj;
+  for(int u=0; u<S3; u++) {
+    cell *c1 = c->move(u+u);
+    if(!c1) return false;
+    adj.push_back(heptagon_address(c1->master));
+    }
+  sort(adj.begin(), adj.end());
+  addr = 0x4E8;
+  for(auto a: adj) addr = address_mix(addr, a);
+  return true;
+  }
+
+cell_rng_scope::cell_rng_scope(cell *c, unsigned purpose) : rng(0, purpose) {
+  active = cell_rng_mode && ls::single();
+  if(!active) return;
+  saved = active_cell_rng;
+  unsigned long long addr;
+  if(cell_address(c, addr)) {
+    rng = cell_rng(addr, purpose);
+    active_cell_rng = &rng;
+    }
+  else active_cell_rng = nullptr;
+  }
+
+cell_rng_scope::~cell_rng_scope() {
+  if(active) active_cell_rng = saved;
+  }
+
+void clear_heptagon_addresses() {
+  #if CAP_THREAD
+  std::unique_lock<std::mutex> lk(heptagon_addresses_lock);
+  #endif
+  heptagon_addresses.clear();
+  }
+
+auto clear_addresses = addHook(hooks_clearmemory, 0, clear_heptagon_addresses)
+  + addHook(hooks_removecells, 0, clear_heptagon_addresses);
+
+/** \brief the next 32-bit value from active_cell_rng if set, or hrngen otherwise */
+EX unsigned hrng_raw() {
+  if(active_cell_rng) return active_cell_rng->next();
+  return hrngen() - hrngen.min();
+  }
+
 /** \brief initialize \link hrngen \endlink */
 EX void shrand(int i) {
   hrngen.seed(i);
+  cell_rng_seed = i;
   }
 
 /** \brief generate a large number with \link hrngen \endlink */
-EX int hrandpos() { return hrngen() & HRANDMAX; }
+EX int hrandpos() { return hrng_raw() & HRANDMAX; }
 
 /** \brief A random integer from [0..i), generated from \link hrngen \endlink.
  *
@@ -33,7 +192,7 @@ EX int hrandpos() { return hrngen() & HRANDMAX; }
  **/
 
 EX int hrand(int i) { 
-  unsigned d = hrngen() - hrngen.min();
+  unsigned d = hrng_raw();
   long long m = (long long) (hrngen.max() - hrngen.min()) + 1;
   m /= i;
   d /= m;
@@ -63,7 +222,7 @@ EX vector<int> hrandom_permutation(int qty) {
  */
 
 EX ld hrandf() { 
-  return (hrngen() - hrngen.min()) / (hrngen.max() + 1.0 - hrngen.min());
+  return hrng_raw() / (hrngen.max() + 1.0 - hrngen.min());
   }
 
 /** Returns an integer corresponding to the current state of \link hrngen \endlink.
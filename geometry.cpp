@@ -478,7 +478,8 @@ hpcshape
   void make_wall(int id, const vector<hyperpoint> vertices, vector<ld> weights = equal_weights);
   
   void reserve_wall3d(int i);
-  void compute_cornerbonus();
+  /** update corner_bonus for the walls from the given index on (0 = recompute) */
+  void compute_cornerbonus(int from = 0);
   void create_wall3d();
   void configure_floorshapes();
   
@@ -4275,6 +4275,10 @@ EX subcellshape& generate_subcellshape_if_needed(cell *c, int id) {
   return ss;
   }
 
+/** while positive, the vertices of newly generated walls are not uploaded yet */
+EX int wall_batch_depth;
+bool wall_batch_pending;
+
 int hrmap::wall_offset(cell *c) {
   int id = currentmap->full_shvid(c);
 
@@ -4298,12 +4302,42 @@ int hrmap::wall_offset(cell *c) {
       }
     
     cgi.wallstart.push_back(isize(cgi.raywall));
-    cgi.compute_cornerbonus();
-    cgi.extra_vertices();
+    cgi.compute_cornerbonus(wo);
+    if(wall_batch_depth) wall_batch_pending = true;
+    else cgi.extra_vertices();
     }
   return wo;
   }
 
+#if HDR
+/** \brief while this exists, the walls generated lazily by wall_offset are uploaded together, when it is destroyed */
+struct wall_batch {
+  wall_batch();
+  ~wall_batch();
+  };
+#endif
+
+wall_batch::wall_batch() { wall_batch_depth++; }
+
+wall_batch::~wall_batch() {
+  wall_batch_depth--;
+  if(!wall_batch_depth && wall_batch_pending) {
+    wall_batch_pending = false;
+    cgi.extra_vertices();
+    }
+  }
+
+/** in bounded maps where the wall shapes depend on the cell, generate them all up front, in a single batch */
+EX void prepare_wall_atlas() {
+  if(WDIM != 3 || !(mhybrid || reg3::in())) return;
+  if(!closed_manifold || (cgflags & qHUGE_BOUNDED) || (mhybrid && hybrid::csteps == 0)) return;
+  static pair<hrmap*, geometry_information*> prepared;
+  if(prepared == make_pair(currentmap, &cgi)) return;
+  prepared = make_pair(currentmap, &cgi);
+  wall_batch wb;
+  for(cell *c: currentmap->allcells()) currentmap->wall_offset(c);
+  }
+
 EX void queue_transparent_wall(const shiftmatrix& V, hpcshape& sh, color_t color) {
   auto& poly = queuepolyat(V, sh, color, PPR::TRANSPARENT_WALL);
   shiftpoint h = V * sh.intester;
@@ -5324,7 +5358,11 @@ EX void drawthemap() {
   arrowtraps.clear();
 
   make_actual_view();
-  currentmap->draw_all();
+  prepare_wall_atlas();
+  if(1) {
+    wall_batch wb;
+    currentmap->draw_all();
+    }
   drawWormSegments();
   drawBlizzards();
   drawArrowTraps();
@@ -369,6 +369,42 @@ EX string scanline_noblank(fhstream& hs) {
   return s;
   }
 
+/** a line of any length, without the line end */
+string scanline_long(fhstream& hs) {
+  string s;
+  int c;
+  while((c = fgetc(hs.f)) != EOF && c != '\n') s += char(c);
+  if(s.size() && s.back() == '\r') s.pop_back();
+  return s;
+  }
+
+/** \brief look up key in a cache file written by cache_append
+ *  The file consists of pairs of lines: a key and its data. accept is called on the data of every entry for key,
+ *  in order; it should return false (and not change anything) if the data is invalid.
+ *  @return true if some entry has been accepted
+ */
+EX bool cache_lookup(const string& fname, const string& key, const function<bool(const string&)>& accept) {
+  if(fname == "") return false;
+  fhstream f(fname, "rt");
+  if(!f.f) return false;
+  bool found = false;
+  while(!feof(f.f)) {
+    string k = scanline_long(f);
+    string data = scanline_long(f);
+    if(k == key && accept(data)) found = true;
+    }
+  return found;
+  }
+
+/** append an entry for key to the cache file fname (see cache_lookup) */
+EX void cache_append(const string& fname, const string& key, const string& data) {
+  if(fname == "") return;
+  fhstream f(fname, "at");
+  if(!f.f) return;
+  println(f, key);
+  println(f, data);
+  }
+
 /*
 string fts_smartdisplay(ld x, int maxdisplay) {
   string rv;
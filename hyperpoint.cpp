@@ -2082,6 +2082,116 @@ EX unsigned bucketer(hyperpoint h) {
   return dx;
   }  
 
+#if HDR
+/** \brief a set of points, where points which differ only by numerical errors are identified
+ *
+ *  Unlike comparing the results of bucketer, this also matches points which lie on the opposite
+ *  sides of a bucket boundary. All points are kept in flat vectors, chained by the hash of their
+ *  grid cell (and tag); neighbor grid cells are probed only for points near the cell boundaries.
+ *  Tags let a single welder hold many independent point sets (e.g., one per heptagon).
+ */
+struct vertex_welder {
+  ld eps, step;
+  /** the points, as added */
+  vector<hyperpoint> points;
+  vector<int> tags;
+  vector<int> next;
+  std::unordered_map<size_t, int> head;
+
+  vertex_welder(ld eps = 1e-6, ld step = 1e-3) : eps(eps), step(step) {}
+  void clear() { points.clear(); tags.clear(); next.clear(); head.clear(); }
+  int size() const { return isize(points); }
+
+  /** add a new point, even if an equal one exists; returns its index */
+  int add(hyperpoint h, int tag = 0);
+  /** the index of the first point added equal to h, or -1 */
+  int find(hyperpoint h, int tag = 0) const;
+  /** the indices of all points equal to h, in the order they were added */
+  void find_all(hyperpoint h, int tag, vector<int>& res) const;
+  /** the index of a point equal to h, adding h if there is none */
+  int weld(hyperpoint h, int tag = 0);
+
+  private:
+  hyperpoint canonical(hyperpoint h) const;
+  size_t cell_hash(const hyperpoint& h, int tag, const array<int, 4>& shift) const;
+  bool equal(const hyperpoint& h1, const hyperpoint& h2) const;
+  void probe(hyperpoint h, int tag, vector<int>* res, int& first, bool mirrored) const;
+  };
+#endif
+
+hyperpoint vertex_welder::canonical(hyperpoint h) const {
+  if(elliptic && h[LDIM] < 0) h = -h;
+  return h;
+  }
+
+size_t vertex_welder::cell_hash(const hyperpoint& h, int tag, const array<int, 4>& shift) const {
+  size_t res = std::hash<int>()(tag);
+  for(int i=0; i<MDIM; i++) {
+    long long k = (long long)(floor(h[i] / step)) + shift[i];
+    res ^= std::hash<long long>()(k) + 0x9e3779b9 + (res << 6) + (res >> 2);
+    }
+  return res;
+  }
+
+bool vertex_welder::equal(const hyperpoint& h1, const hyperpoint& h2) const {
+  for(int i=0; i<MDIM; i++) if(abs(h1[i] - h2[i]) >= eps) return false;
+  return true;
+  }
+
+void vertex_welder::probe(hyperpoint h, int tag, vector<int>* res, int& first, bool mirrored) const {
+  array<int, 4> lo, hi, shift;
+  for(int i=0; i<4; i++) {
+    lo[i] = hi[i] = 0;
+    if(i >= MDIM) continue;
+    ld frac = h[i] / step - floor(h[i] / step);
+    if(frac < eps / step) lo[i] = -1;
+    if(frac > 1 - eps / step) hi[i] = 1;
+    }
+  for(shift[0]=lo[0]; shift[0]<=hi[0]; shift[0]++)
+  for(shift[1]=lo[1]; shift[1]<=hi[1]; shift[1]++)
+  for(shift[2]=lo[2]; shift[2]<=hi[2]; shift[2]++)
+  for(shift[3]=lo[3]; shift[3]<=hi[3]; shift[3]++) {
+    auto it = head.find(cell_hash(h, tag, shift));
+    if(it == head.end()) continue;
+    for(int id = it->second; id != -1; id = next[id])
+      if(tags[id] == tag && equal(canonical(points[id]), h)) {
+        if(res) res->push_back(id);
+        if(first == -1 || id < first) first = id;
+        }
+    }
+  /* in elliptic space, h and -h are the same point, and only one of them is canonical */
+  if(elliptic && !mirrored && abs(h[LDIM]) < eps) probe(-h, tag, res, first, true);
+  }
+
+int vertex_welder::add(hyperpoint h, int tag) {
+  int id = size();
+  points.push_back(h);
+  tags.push_back(tag);
+  auto& hd = head.emplace(cell_hash(canonical(h), tag, array<int, 4>{{0,0,0,0}}), -1).first->second;
+  next.push_back(hd);
+  hd = id;
+  return id;
+  }
+
+void vertex_welder::find_all(hyperpoint h, int tag, vector<int>& res) const {
+  res.clear();
+  int first = -1;
+  probe(canonical(h), tag, &res, first, false);
+  sort(res.begin(), res.end());
+  res.erase(std::unique(res.begin(), res.end()), res.end());
+  }
+
+int vertex_welder::find(hyperpoint h, int tag) const {
+  int first = -1;
+  probe(canonical(h), tag, nullptr, first, false);
+  return first;
+  }
+
+int vertex_welder::weld(hyperpoint h, int tag) {
+  int id = find(h, tag);
+  return id == -1 ? add(h, tag) : id;
+  }
+
 #if MAXMDIM >= 4
 /** @brief project the origin to the triangle [h1,h2,h3] */
 EX hyperpoint project_on_triangle(hyperpoint h1, hyperpoint h2, hyperpoint h3) {
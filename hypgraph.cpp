@@ -1820,28 +1820,40 @@ void hrmap::draw_at(cell *at, const shiftmatrix& where) {
   auto& enq = confusingGeometry() ? dq::enqueue_by_matrix_c : dq::enqueue_c;
   
   enq(at, where);
+
+  /* the queue is processed in layers, so that draw_distance can be computed for the whole layer at once */
+  vector<pair<cell*, shiftmatrix>> layer;
+  vector<ld> dists;
       
   while(!dq::drawqueue_c.empty()) {
-    auto& p = dq::drawqueue_c.front();
-    cell *c = p.first;
-    shiftmatrix V = p.second;
-    dq::drawqueue_c.pop();
-    
-    if(!do_draw(c, V)) continue;
-    drawcell(c, V);
-    if(in_wallopt() && isWall3(c) && isize(dq::drawqueue) > 1000) continue;
-
-    #if MAXMDIM >= 4
-    if(reg3::ultra_mirror_in())
-      for(auto& T: cgi.ultra_mirrors) 
-        enq(c, optimized_shift(V * T));
-    #endif
+    layer.clear();
+    while(!dq::drawqueue_c.empty()) {
+      layer.push_back(dq::drawqueue_c.front());
+      dq::drawqueue_c.pop();
+      }
+    bool need_dist = draw_distance_needed();
+    if(need_dist) draw_distances(layer, dists);
+
+    for(int li=0; li<isize(layer); li++) {
+      cell *c = layer[li].first;
+      const shiftmatrix& V = layer[li].second;
+    
+      if(!do_draw(c, V, need_dist ? dists[li] : 0)) continue;
+      drawcell(c, V);
+      if(in_wallopt() && isWall3(c) && isize(dq::drawqueue) > 1000) continue;
+
+      #if MAXMDIM >= 4
+      if(reg3::ultra_mirror_in())
+        for(auto& T: cgi.ultra_mirrors) 
+          enq(c, optimized_shift(V * T));
+      #endif
     
-    for(int i=0; i<c->type; i++) {
-      // note: need do cmove before c.spin
-      cell *c1 = c->cmove(i);      
-      if(c1 == &out_of_bounds) continue;
-      enq(c1, optimized_shift(V * adj(c, i)));
+      for(int i=0; i<c->type; i++) {
+        // note: need do cmove before c.spin
+        cell *c1 = c->cmove(i);      
+        if(c1 == &out_of_bounds) continue;
+        enq(c1, optimized_shift(V * adj(c, i)));
+        }
       }
     }
   }
@@ -2993,7 +3005,45 @@ bool limited_generation(cell *c) {
 
 EX int min_cells_drawn = 50;
 
+/** do_draw needs draw_distance in the current geometry */
+EX bool draw_distance_needed() {
+  #if MAXMDIM >= 4
+  return WDIM == 3 && (nil || nih) && models::is_perspective(pmodel);
+  #else
+  return false;
+  #endif
+  }
+
+/** the limit on draw_distance */
+ld draw_distance_limit() {
+  return sightranges[geometry] + (vid.sloppy_3d ? 0 : nil ? 0.9 : cgi.corner_bonus);
+  }
+
+/** the geodesic distance to tC0(T), as used by do_draw; if it is beyond draw_distance_limit(), a lower bound may be returned instead */
+EX ld draw_distance(const shiftmatrix& T) {
+  /* in Nil, the projection to the xy plane does not increase lengths */
+  if(nil && hypot_d(2, tC0(T.T)) > draw_distance_limit()) return hypot_d(2, tC0(T.T));
+  return hypot_d(3, inverse_exp(tC0(T), pQUICK));
+  }
+
+/** draw_distance for a batch of cells, computed in parallel for large batches */
+EX void draw_distances(const vector<pair<cell*, shiftmatrix>>& batch, vector<ld>& res) {
+  int N = isize(batch);
+  res.resize(N);
+  if(!N) return;
+  /* the first call also loads the tables of inverse_exp, if needed */
+  res[0] = draw_distance(batch[0].second);
+  parallel_ranges(N-1, N >= 1024 ? available_threads() : 1, [&] (int from, int to, int) {
+    for(int i=from; i<to; i++) res[i+1] = draw_distance(batch[i+1].second);
+    });
+  }
+
 EX bool do_draw(cell *c, const shiftmatrix& T) {
+  return do_draw(c, T, draw_distance_needed() ? draw_distance(T) : 0);
+  }
+
+/** do_draw with draw_distance(T) already known (it is ignored when !draw_distance_needed()) */
+EX bool do_draw(cell *c, const shiftmatrix& T, ld dist) {
 
   if(WDIM == 3) {
     // do not care about cells outside of the track
@@ -3003,8 +3053,7 @@ EX bool do_draw(cell *c, const shiftmatrix& T) {
     if(cells_drawn < min_cells_drawn) { limited_generation(c); return true; }
     #if MAXMDIM >= 4
     if(nil && models::is_perspective(pmodel)) {
-      ld dist = hypot_d(3, inverse_exp(tC0(T), pQUICK));
-      if(dist > sightranges[geometry] + (vid.sloppy_3d ? 0 : 0.9)) return false;
+      if(dist > draw_distance_limit()) return false;
       if(dist <= extra_generation_distance && !limited_generation(c)) return false;
       }
     else if(sol && models::is_perspective(pmodel)) {
@@ -3012,13 +3061,13 @@ EX bool do_draw(cell *c, const shiftmatrix& T) {
       if(!limited_generation(c)) return false;
       }
     else if(nih && models::is_perspective(pmodel)) {
-      hyperpoint h = inverse_exp(tC0(T), pQUICK);
-      ld dist = hypot_d(3, h);
-      if(dist > sightranges[geometry] + (vid.sloppy_3d ? 0 : cgi.corner_bonus)) return false;
+      if(dist > draw_distance_limit()) return false;
       if(dist <= extra_generation_distance && !limited_generation(c)) return false;
       }
     else if(sl2 && models::is_perspective(pmodel)) {
-      if(hypot(tC0(T.T)[2], tC0(T.T)[3]) > cosh(slr::range_xy)) return false;
+      static ld last_range_xy = -1, cosh_range_xy;
+      if(slr::range_xy != last_range_xy) last_range_xy = slr::range_xy, cosh_range_xy = cosh(slr::range_xy);
+      if(hypot(tC0(T.T)[2], tC0(T.T)[3]) > cosh_range_xy) return false;
       if(abs(T.shift) > (slr::range_z)) return false;
       if(abs(T.shift * stretch::not_squared()) > sightranges[geometry]) return false;
       if(!limited_generation(c)) return false;
@@ -13,6 +13,10 @@ struct intra_data {
   gamedata gd;
   geometryinfo gi;
   int wallindex;  
+  /** wall offsets of the cells of this space, so that they can be queried from other spaces without switching */
+  std::unordered_map<cell*, int> wall_offsets;
+  /** the cgi of this space in which wall_offsets were computed */
+  geometry_information *wall_offsets_cgi;
   };
 #endif
 
@@ -24,6 +28,9 @@ EX bool switching;
 /** index of the space we are currently in */
 EX int current;
 
+/** the number of actual switches between spaces, for benchmarking */
+EX int switches;
+
 /** portal debugging flags */
 EX int debug_portal;
 
@@ -328,13 +335,22 @@ EX connection_data* find_connection(int a, int b) {
   return nullptr;
   }
 
+/** forget the wall offsets of the current space if its cgi has been replaced */
+void check_wall_offsets() {
+  auto& d = data[current];
+  if(d.wall_offsets_cgi != cgip) d.wall_offsets.clear(), d.wall_offsets_cgi = cgip;
+  }
+
 EX void switch_to(int id) {
   if(current == id) return;
+  switches++;
   dynamicval<bool> is(switching, true);
+  check_wall_offsets();
   data[current].gd.storegame();
   current = id;
   ginf[gProduct] = data[current].gi;
   data[current].gd.restoregame();
+  check_wall_offsets();
   }
 
 void connect_portal_1(cellwalker cw1, cellwalker cw2, int spin) {
@@ -431,6 +447,7 @@ EX void regenerate_full_sample_list() {
   resetter ir;
   full_sample_list.clear();
   for(int i=0; i<isize(data); i++) {
+    data[i].wall_offsets.clear();
     switch_to(i);
     generate_sample_list_for_current();
     }
@@ -453,10 +470,11 @@ EX void become() {
   current = isize(data);
   for(cell *c: ac)
     intra_id[c] = current;
+  data.emplace_back();
+  data.back().wall_offsets_cgi = cgip;
   for(cell *c: ac)
-    currentmap->wall_offset(c);
+    data.back().wall_offsets[c] = currentmap->wall_offset(c);
   for(cell *c: ac) c->item = itNone;
-  data.emplace_back();
   data.back().gd.storegame();
   data.back().gi = ginf[gProduct];
   generate_sample_list_for_current();
@@ -499,8 +517,30 @@ EX void may_switch_to(cell *c) {
   if(in) switch_to(intra_id.at(c));
   }
 
+/** wall offset of c in its own space; known offsets do not require switching */
+EX int local_wall_offset(cell *c) {
+  if(!in) return currentmap->wall_offset(c);
+  int id = intra_id.at(c);
+  if(id == current) check_wall_offsets();
+  auto& wo = data[id].wall_offsets;
+  auto it = wo.find(c);
+  if(it != wo.end()) return it->second;
+  resetter ir;
+  switch_to(id);
+  return wo[c] = currentmap->wall_offset(c);
+  }
+
+/* the offsets are recomputed on demand, so they can be forgotten whenever the cells or walls may change */
+auto clear_wall_offsets = addHook(hooks_clearmemory, 40, [] { for(auto& d: data) d.wall_offsets.clear(); })
+  + addHook(hooks_removecells, 40, [] {
+    for(auto& d: data)
+      for(auto it = d.wall_offsets.begin(); it != d.wall_offsets.end();)
+        if(is_cell_removed(it->first)) it = d.wall_offsets.erase(it);
+        else it++;
+    });
+
 EX int full_wall_offset(cell *c) {
-  int wo = currentmap->wall_offset(c);
+  int wo = local_wall_offset(c);
   if(in) wo += data[intra_id.at(c)].wallindex;
   return wo;
   }
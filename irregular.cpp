@@ -38,7 +38,7 @@ struct cellinfo {
   };
 #endif
 
-EX map<cell*, int> cellindex;
+EX std::unordered_map<cell*, int> cellindex;
 
 EX vector<cellinfo> cells;
 
@@ -150,7 +150,7 @@ EX bool collectItem(cell *c2, cell *last, bool telekinesis IS(false)) {
     
     if(it == itOrbPurity) {
       bool no_curses = true;
-      for(cell *c: dcal) if(c->land == laCursed) no_curses = false;
+      if(!dcal_in_land(laCursed).empty()) no_curses = false;
       if(no_curses) {
         items[itOrbSpeed] += 5;
         items[itOrbWinter] += 5;
@@ -2855,6 +2855,9 @@ EX void setdist(cell *c, int d, cell *from) {
   if(c->mpdist <= d) return;
   if(c->mpdist > d+1 && d < BARLEV) setdist(c, d+1, from);
   c->mpdist = d;
+
+  /* in cell_rng_mode, random decisions made here depend only on c and d */
+  cell_rng_scope crs(c, d);
   
   // this fixes the following problem:
   // http://steamcommunity.com/app/342610/discussions/0/1470840994970724215/
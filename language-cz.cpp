@@ -9059,7 +9059,7 @@ S(
           "wallif(podmínka, barva)\n"
           )
 
-S("see compute_map_function in pattern2.cpp for more\n", "více informací ve funkci compute_map_function v pattern2.cpp")
+S("see map_function_variables in pattern2.cpp for more\n", "více informací ve funkci map_function_variables v pattern2.cpp")
 
 S("broken Emerald Pattern", "rozbitý Smaragdový vzor")
 S("single cells", "jednotlivá políčka")
@@ -8674,7 +8674,7 @@ S(
           "wallif(condition, couleur)\n"
           )
 
-S("see compute_map_function in pattern2.cpp for more\n", "voir la fonction compute_map_function dans pattern2.cpp")
+S("see map_function_variables in pattern2.cpp for more\n", "voir la fonction map_function_variables dans pattern2.cpp")
 
 S("broken Emerald Pattern", "Motif d'émeraude cassé")
 S("single cells", "cases seules")
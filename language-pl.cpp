@@ -8777,7 +8777,7 @@ S(
           "wallif(warunek, kolor)\n"
           )
 
-S("see compute_map_function in pattern2.cpp for more\n", "obejrzyj funkcję compute_map_function w pattern2.cpp")
+S("see map_function_variables in pattern2.cpp for more\n", "obejrzyj funkcję map_function_variables w pattern2.cpp")
 
 S("broken Emerald Pattern", "rozbity Szmaragdowy Wzór")
 S("single cells", "pojedyncze pola")
@@ -451,6 +451,62 @@ struct celllister : manual_celllister {
   int getdist(cell *c) { return dists[c->listindex]; }
   };
 
+/** \brief a hash map from cells to non-negative indices, using open addressing
+ *
+ *  Used instead of cell::listindex when several traversals must coexist.
+ */
+struct cell_index_map {
+  vector<pair<cell*, int>> table;
+  int qty;
+  cell_index_map() : qty(0) {}
+  static size_t hash(cell *c) { return size_t((uintptr_t(c) >> 4) * 0x9E3779B97F4A7C15ull); }
+  /** \brief the index of c, or -1 if c is not in the map */
+  int find(cell *c) const {
+    if(table.empty()) return -1;
+    size_t mask = table.size() - 1;
+    for(size_t i = hash(c) & mask;; i = (i+1) & mask) {
+      if(table[i].first == c) return table[i].second;
+      if(!table[i].first) return -1;
+      }
+    }
+  /** \brief add c with the given index; returns false (and does nothing) if c is already present */
+  bool insert(cell *c, int id);
+  void clear() { table.clear(); qty = 0; }
+  };
+
+/** \brief a re-entrant variant of celllister
+ *
+ *  Visited cells are recorded in a cell_index_map owned by the traversal, rather than in cell::listindex.
+ *  Therefore any number of cellbfs objects may be active at once, in any order, and also in parallel threads,
+ *  as long as no cells are being created meanwhile (use create == false, or a map where all the cells already exist).
+ */
+struct cellbfs {
+  vector<cell*> lst;
+  vector<int> dists;
+  cell_index_map index;
+
+  bool listed(cell *c) const { return index.find(c) >= 0; }
+  /** \brief for a given cell c on the list, return its distance from orig */
+  int getdist(cell *c) const { return dists[index.find(c)]; }
+  bool add_at(cell *c, int d) {
+    if(!index.insert(c, isize(lst))) return false;
+    lst.push_back(c); dists.push_back(d);
+    return true;
+    }
+
+  cellbfs() {}
+  /** \brief the same list as celllister(orig, maxdist, maxcount, breakon); if create is false, only the existing cells are visited */
+  cellbfs(cell *orig, int maxdist, int maxcount, cell *breakon, bool create = true);
+
+  /** \brief level-synchronous BFS with each frontier expanded by several threads; never creates cells
+   *
+   *  If universe (the list of all the cells which could be reached) is given, large frontiers are
+   *  expanded bottom-up (each unvisited cell checks whether it has a neighbor in the frontier).
+   *  Cells at each distance are listed in a deterministic order, which does not depend on threads.
+   */
+  void parallel(cell *orig, int maxdist, int threads, const vector<cell*> *universe = nullptr);
+  };
+
 /** \brief translate heptspins to cellwalkers and vice versa */
 static const struct cth_t { cth_t() {}} cth;
 inline heptspin operator+ (cellwalker cw, cth_t) { return heptspin(cw.at->master, cw.spin * DUALMUL, cw.mirrored); }
@@ -460,6 +516,84 @@ inline cellwalker operator+ (heptspin hs, cth_t) { return cellwalker(hs.at->c7,
 
 EX bool proper(cell *c, int d) { return d >= 0 && d < c->type; }
 
+bool cell_index_map::insert(cell *c, int id) {
+  if(2 * (qty+1) > isize(table)) {
+    vector<pair<cell*, int>> old;
+    swap(old, table);
+    table.resize(max<int>(16, 2 * isize(old)), make_pair(nullptr, -1));
+    qty = 0;
+    for(auto& p: old) if(p.first) insert(p.first, p.second);
+    }
+  size_t mask = table.size() - 1;
+  for(size_t i = hash(c) & mask;; i = (i+1) & mask) {
+    if(table[i].first == c) return false;
+    if(!table[i].first) {
+      table[i] = make_pair(c, id);
+      qty++;
+      return true;
+      }
+    }
+  }
+
+cellbfs::cellbfs(cell *orig, int maxdist, int maxcount, cell *breakon, bool create) {
+  add_at(orig, 0);
+  cell *last = orig;
+  for(int i=0; i<isize(lst); i++) {
+    cell *c = lst[i];
+    if(maxdist) for(int j=0; j<c->type; j++) {
+      cell *c2 = create ? c->cmove(j) : c->move(j);
+      if(!c2) continue;
+      add_at(c2, dists[i]+1);
+      if(c2 == breakon) return;
+      }
+    if(c == last) {
+      if(isize(lst) >= maxcount || dists[i]+1 == maxdist) break;
+      last = lst.back();
+      }
+    }
+  }
+
+void cellbfs::parallel(cell *orig, int maxdist, int threads, const vector<cell*> *universe) {
+  lst.clear(); dists.clear(); index.clear();
+  add_at(orig, 0);
+  int layer_start = 0;
+  threads = max(threads, 1);
+  vector<vector<cell*>> found(threads);
+  for(int d=0; d<maxdist && layer_start < isize(lst); d++) {
+    int layer_end = isize(lst);
+    int frontier = layer_end - layer_start;
+    for(auto& f: found) f.clear();
+    /* the index is only read during the parallel phase */
+    if(universe && frontier * 14 > isize(*universe) - isize(lst)) {
+      parallel_ranges(isize(*universe), threads, [&] (int a, int b, int k) {
+        for(int i=a; i<b; i++) {
+          cell *c = (*universe)[i];
+          if(listed(c)) continue;
+          for(int j=0; j<c->type; j++) {
+            cell *c2 = c->move(j);
+            if(!c2) continue;
+            int id = index.find(c2);
+            if(id >= layer_start && id < layer_end) { found[k].push_back(c); break; }
+            }
+          }
+        });
+      }
+    else {
+      parallel_ranges(frontier, threads, [&] (int a, int b, int k) {
+        for(int i=layer_start+a; i<layer_start+b; i++) {
+          cell *c = lst[i];
+          for(int j=0; j<c->type; j++) {
+            cell *c2 = c->move(j);
+            if(c2 && !listed(c2)) found[k].push_back(c2);
+            }
+          }
+        });
+      }
+    for(auto& f: found) for(cell *c: f) add_at(c, d+1);
+    layer_start = layer_end;
+    }
+  }
+
 #if HDR
 
 constexpr int STRONGWIND = 199;
@@ -1,10 +1,20 @@
 // generate autohdr.h based on the `EX` and `#if HDR` in *.cpp files
+
+// Options:
+//   -o file -- write to the given file rather than stdout; the file is not rewritten
+//     if its contents would not change, so that its timestamp changes only when needed
+//   -ignore-lines -- with -o, also keep the file if only the #line directives would change;
+//     faster rebuilds, but compiler messages may then point to wrong lines
+//   -cache file -- reuse the declarations extracted from files whose contents did not change
+
 #include <cstdio>
 #include <iostream>
 #include <fstream>
+#include <sstream>
 #include <string>
 #include <vector>
 #include <set>
+#include <map>
 #include <cstdlib>
 
 using namespace std;
@@ -15,16 +25,18 @@ string ind() { string s; for(int i=0; i<indent; i++) s += ' '; return s; }
 
 string which_file;
 
+stringstream out;
+
 vector<string> if_stack;
 int ifs_level;
 
 void mark_file() {
   if(which_file != "") {
-    cout << "\n" << ind() << "// implemented in: " << which_file << "\n\n";
+    out << "\n" << ind() << "// implemented in: " << which_file << "\n\n";
     which_file = "";
     }
   while(ifs_level < (int) if_stack.size())
-    cout << ind() << if_stack[ifs_level++] << "\n";
+    out << ind() << if_stack[ifs_level++] << "\n";
   }
 
 int in_hdr;
@@ -33,11 +45,9 @@ set<string> seen;
 
 int lineid;
 
-void gen(string sf) {
-  if(seen.count(sf)) return;
-  seen.insert(sf);
+void gen(string sf, const string& content) {
   which_file = sf; lineid = 1;
-  ifstream in(sf.c_str());
+  stringstream in(content);
   string s;
   while(getline(in, s)) {
     lineid++;
@@ -49,12 +59,12 @@ void gen(string sf) {
       if(s.substr(0, 3) == "#if")
         in_hdr++;
       if(in_hdr)
-        cout << ind() << s << "\n";
+        out << ind() << s << "\n";
       continue;
       }
     if(s == "#if HDR") {
       mark_file();
-      cout << "#line " << lineid << " \"" << sf << "\"\n";
+      out << "#line " << lineid << " \"" << sf << "\"\n";
       in_hdr = true;
       continue;
       }
@@ -69,37 +79,37 @@ void gen(string sf) {
       if(if_stack.empty()) { cerr << "if_stack error " << which_file << ", " << s << "\n"; exit(1); }
       if_stack.pop_back();
       while(ifs_level > (int) if_stack.size())
-        cout << ind() << "#endif\n", ifs_level--;
+        out << ind() << "#endif\n", ifs_level--;
       }
     if(s.substr(0, 4) == "EX }") {
       mark_file();
-      cout << ind() << "}\n";
+      out << ind() << "}\n";
       indent -= 2;
       }
     else if(s.substr(0, 3) == "EX ") {
       string t = s.substr(3);
       if(t.substr(0, 10) == "namespace ") {
         mark_file();
-        cout << ind() << t << "\n";
+        out << ind() << t << "\n";
         indent += 2;
         }
       else {
         mark_file();
-        cout << "#line " << lineid-1 << " \"" << sf << "\"\n";
+        out << "#line " << lineid-1 << " \"" << sf << "\"\n";
         for(int i=0;; i++) {
           if(i == int(t.size())) { cerr << "Error: unrecognizable EX: " << s << "\n"; }
           else if(t[i] == '{') {
             while(i && t[i-1] == ' ') i--;
-            cout << ind() << t.substr(0, i) << ";\n";
+            out << ind() << t.substr(0, i) << ";\n";
             break;
             }
           else if(t[i] == ';') {
-            cout << ind() << "extern " << t << "\n";
+            out << ind() << "extern " << t << "\n";
             break;
             }
           else if(t[i] == '=') {
             while(i && t[i-1] == ' ') i--;
-            cout << ind() << "extern " << t.substr(0, i) << ";\n";
+            out << ind() << "extern " << t.substr(0, i) << ";\n";
             break;
             }
           }
@@ -108,20 +118,97 @@ void gen(string sf) {
     }
   
   while(ifs_level > (int) if_stack.size())
-    cout << ind() << "#endif\n", ifs_level--;
+    out << ind() << "#endif\n", ifs_level--;
 
   while(indent > 2) {
-    cout << ind() << "}\n";
+    out << ind() << "}\n";
     indent -= 2;
     }
   }
 
+string read_file(const string& fname) {
+  ifstream ifs(fname.c_str(), ios::binary);
+  return string(istreambuf_iterator<char>(ifs), istreambuf_iterator<char>());
+  }
+
+/* FNV-1a */
+string content_hash(const string& s) {
+  unsigned long long h = 14695981039346656037ull;
+  for(char c: s) { h ^= (unsigned char) c; h *= 1099511628211ull; }
+  char buf[20];
+  snprintf(buf, 20, "%016llx", h);
+  return buf;
+  }
+
+/* cache file format: for each source, a line 'name hash length', followed by length bytes of output */
+map<string, pair<string, string>> read_cache(const string& fname) {
+  map<string, pair<string, string>> res;
+  ifstream ifs(fname.c_str(), ios::binary);
+  string name, hash;
+  size_t len;
+  while(ifs >> name >> hash >> len) {
+    ifs.get();
+    string data(len, 0);
+    if(len && !ifs.read(&data[0], len)) break;
+    res[name] = make_pair(hash, data);
+    }
+  return res;
+  }
+
+/* the contents without the #line directives */
+string without_lines(const string& s) {
+  stringstream in(s);
+  string res, line;
+  while(getline(in, line)) if(line.substr(0, 6) != "#line ") res += line, res += "\n";
+  return res;
+  }
+
 int main(int argc, char ** argv) {
-  printf("// This file is generated automatically by makeh.cpp.\n\nnamespace hr {\n");
+  string outname, cachename;
+  bool ignore_lines = false;
+  vector<string> files;
+  for(int i=1; i<argc; i++) {
+    string a = argv[i];
+    if(a == "-o" && i+1 < argc) outname = argv[++i];
+    else if(a == "-cache" && i+1 < argc) cachename = argv[++i];
+    else if(a == "-ignore-lines") ignore_lines = true;
+    else files.push_back(a);
+    }
+
+  map<string, pair<string, string>> cache, newcache;
+  if(cachename != "") cache = read_cache(cachename);
+
+  string result = "// This file is generated automatically by makeh.cpp.\n\nnamespace hr {\n";
   indent = 2;
   
-  for(int i=1; i<argc; i++) 
-    gen(argv[i]);
+  for(auto& sf: files) {
+    if(seen.count(sf)) continue;
+    seen.insert(sf);
+    string content = read_file(sf);
+    string hash = content_hash(content);
+    auto it = cache.find(sf);
+    if(it != cache.end() && it->second.first == hash) {
+      result += it->second.second;
+      newcache[sf] = it->second;
+      continue;
+      }
+    out.str(""); out.clear();
+    gen(sf, content);
+    string block = out.str();
+    result += block;
+    newcache[sf] = make_pair(hash, block);
+    }
   
-  printf("  }\n");
+  result += "  }\n";
+
+  if(cachename != "") {
+    ofstream ofs(cachename.c_str(), ios::binary);
+    for(auto& p: newcache)
+      ofs << p.first << " " << p.second.first << " " << p.second.second.size() << "\n" << p.second.second;
+    }
+
+  if(outname == "") { cout << result; return 0; }
+  string old = read_file(outname);
+  if(ignore_lines ? without_lines(old) == without_lines(result) : old == result) return 0;
+  ofstream(outname.c_str(), ios::binary) << result;
   }
@@ -1586,15 +1586,15 @@ EX namespace mapeditor {
   
   vector<pair<cellwalker, cellwalker> > spill_list;
   
-  void list_spill(cellwalker tgt, cellwalker src, manual_celllister& cl) {
-    spill_list.clear(); 
-    spill_list.emplace_back(tgt, src);
+  /** list the cells to edit, spilling from all the given (target, source) pairs in a single traversal, up to distance rad */
+  void list_spill(const vector<pair<cellwalker, cellwalker> >& from, manual_celllister& cl, int rad) {
+    spill_list = from;
     if(painttype == 7) return;
     int crad = 0, nextstepat = 0;
     for(int i=0; i<isize(spill_list); i++) {
       if(i == nextstepat) {
         crad++; nextstepat = isize(spill_list);
-        if(crad > radius) break;
+        if(crad > rad) break;
         }
       auto sd = spill_list[i];
       for(int i=0; i<sd.first.at->type; i++) {
@@ -1610,16 +1610,21 @@ EX namespace mapeditor {
       }
     }
 
-  void editAt(cellwalker where, manual_celllister& cl) {
-
+  /** adjust the spill target; returns false if it cannot be edited */
+  bool prepare_spill(cellwalker& where) {
     if(painttype == 4 && radius) {
-      if(where.at->type != copysource.at->type) return;
+      if(where.at->type != copysource.at->type) return false;
       if(where.spin<0) where.spin=0;
       if(BITRUNCATED && !ctof(mouseover) && ((where.spin&1) != (copysource.spin&1)))
         where += 1;
       }
     if(painttype != 4) copysource.at = NULL;
-    list_spill(where, copysource, cl);
+    return true;
+    }
+
+  void editAt(cellwalker where, manual_celllister& cl) {
+    if(!prepare_spill(where)) return;
+    list_spill({make_pair(where, copysource)}, cl, radius);
     
     for(auto& st: spill_list)
       editCell(st);
@@ -1633,27 +1638,23 @@ EX namespace mapeditor {
       return;
       }
 
-    cl.add(where.at);
-    
-    int at = 0;
-    while(at < isize(cl.lst)) {
-      cell *c2 = cl.lst[at];
-      at++;
-      
-      forCellEx(c3, c2) cl.add(c3);
-      }
-    
-    auto si = patterns::getpatterninfo0(where.at);
+    auto si = patterns::indexed_patterninfo(where.at);
     int cdir = where.spin;
     if(cdir >= 0) cdir = cdir - si.dir;
     
-    for(cell* c2: cl.lst) {
-      auto si2 = patterns::getpatterninfo0(c2);
-      if(si2.id == si.id) {
-        editAt(cellwalker(c2, cdir>=0 ? cdir + si2.dir : -1), cl);
-        modelcell[si2.id] = c2;
-        }
+    /* the matches are edited without spilling into their neighbors (as before, when every existing
+     * cell was already in the shared lister), so they form a single spill of radius 0 */
+    vector<pair<cellwalker, cellwalker> > targets;
+    for(cell* c2: patterns::cells_in_class(where.at, si.id)) {
+      auto si2 = patterns::indexed_patterninfo(c2);
+      cellwalker tgt(c2, cdir>=0 ? cdir + si2.dir : -1);
+      if(prepare_spill(tgt)) targets.emplace_back(tgt, copysource);
+      modelcell[si2.id] = c2;
       }
+    list_spill(targets, cl, 0);
+
+    for(auto& st: spill_list)
+      editCell(st);
     }
   
   cellwalker mouseover_cw(bool fix) {
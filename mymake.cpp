@@ -7,6 +7,15 @@
 //   -O3 -- optimize
 //   -D... -- change compilation flags
 //   [file.cpp] -- add a module to the build (e.g. ./mymake rogueviz)
+//   -pch -- use precompiled headers (hyper.h, rogueviz/rogueviz.h)
+//   -nohash -- always recompile modules whose source is newer than the object file;
+//      by default, the preprocessed source is compared with the one used to build the object
+//   -unity N -- compile the files included by hyper.cpp as N chunks of similar line counts
+//   -flto -- link-time optimization (as other -f options, passed to both the compiler and the linker)
+//   -pgo-gen, -pgo-use -- profile-guided optimization: build with -pgo-gen, run a workload, then build
+//      again with -pgo-use in place of -pgo-gen and otherwise the same options, e.g.:
+//      ./mymake -O3 -flto -unity 8 -pgo-gen devmods/autoplay && ./hyper -autoplayN 100000
+//      ./mymake -O3 -flto -unity 8 -pgo-use devmods/autoplay
 
 #include <string>
 #include <fstream>
@@ -15,9 +24,14 @@
 #include <vector>
 #include <sys/stat.h>
 #include <unistd.h>
-#include <chrono>
-#include <future>
+#include <map>
 #include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <set>
+#include <algorithm>
+#include <utime.h>
+#include <dirent.h>
 
 using namespace std;
 
@@ -176,11 +190,206 @@ time_t get_file_time(const string s) {
   return res;
   }
 
-int optimized = 0;
+/* the time of a header, including the headers it includes */
+time_t get_header_time(const string& s, set<string>& seen) {
+  if(seen.count(s)) return 0;
+  seen.insert(s);
+  time_t res = get_file_time(s);
+  string dir = s.substr(0, s.rfind('/') + 1);
+  if(s.find('/') == string::npos) dir = "";
+  ifstream ifs(s);
+  string s1;
+  while(getline(ifs, s1)) {
+    if(s1.substr(0, 10) != "#include \"") continue;
+    string t = s1.substr(10);
+    t = t.substr(0, t.find("\""));
+    if(file_exists(dir + t)) res = max(res, get_header_time(dir + t, seen));
+    }
+  return res;
+  }
+
+/* remove the "dir/../" parts from a path */
+string normalize_path(string s) {
+  while(true) {
+    size_t pos = s.find("/../");
+    if(pos == string::npos) break;
+    size_t prev = s.rfind('/', pos - 1);
+    prev = (prev == string::npos || pos == 0) ? 0 : prev + 1;
+    if(s.substr(prev, pos - prev) == "..") break;
+    s = s.substr(0, prev) + s.substr(pos + 4);
+    }
+  return s;
+  }
+
+/* the header included first in src, if nothing else precedes it; used for precompiled headers */
+string first_header(const string& src) {
+  ifstream ifs(src);
+  string s;
+  while(getline(ifs, s)) {
+    while(s.size() && (s.back() == 10 || s.back() == 13)) s.pop_back();
+    if(s.empty() || s[0] != '#') continue;
+    if(s.substr(0, 10) != "#include \"") return "";
+    string t = s.substr(10);
+    t = t.substr(0, t.find("\""));
+    string dir = src.find('/') == string::npos ? "" : src.substr(0, src.rfind('/') + 1);
+    return normalize_path(dir + t);
+    }
+  return "";
+  }
+
+string read_file(const string& fname) {
+  ifstream ifs(fname, ios::binary);
+  return string(istreambuf_iterator<char>(ifs), istreambuf_iterator<char>());
+  }
+
+/* FNV-1a */
+string content_hash(const string& s) {
+  unsigned long long h = 14695981039346656037ull;
+  for(char c: s) { h ^= (unsigned char) c; h *= 1099511628211ull; }
+  char buf[20];
+  snprintf(buf, 20, "%016llx", h);
+  return buf;
+  }
+
+struct task {
+  string name;
+  /* command line to compile */
+  string cmdline;
+  /* if nonempty, preprocess with this command line (to 'obj.E') and skip compiling if the hash did not change */
+  string precmd;
+  string obj;
+  /* the index of the task which has to be finished first, or -1 */
+  int dep;
+  };
+
+int run_task(const task& t) {
+  string hash;
+  if(t.precmd != "") {
+    string efile = t.obj + ".E";
+    if(mysystem(t.precmd + " -o " + efile) == 0) hash = content_hash(t.cmdline + "\n" + read_file(efile));
+    remove(efile.c_str());
+    if(hash != "" && read_file(t.obj + ".hash") == hash && file_exists(t.obj)) {
+      utime(t.obj.c_str(), NULL);
+      if(!quiet) printf("unchanged: %s\n", t.name.c_str());
+      return 0;
+      }
+    }
+  int res = mysystem(t.cmdline);
+  if(res == 0 && hash != "") ofstream(t.obj + ".hash") << hash;
+  return res;
+  }
+
+/* run the tasks using batch_size threads; a task is started only after its dependency is done */
+bool run_tasks(const vector<task>& tasks) {
+  mutex mtx;
+  condition_variable cv;
+  vector<int> state(tasks.size(), 0); // 0 = waiting, 1 = running, 2 = done
+  int tasks_taken = 0;
+  bool failed = false;
+
+  auto worker = [&] () {
+    unique_lock<mutex> lock(mtx);
+    while(true) {
+      if(failed || tasks_taken == (int) tasks.size()) return;
+      int next = -1;
+      for(int i=0; i<(int) tasks.size(); i++)
+        if(state[i] == 0 && (tasks[i].dep == -1 || state[tasks[i].dep] == 2)) { next = i; break; }
+      if(next == -1) { cv.wait(lock); continue; }
+      state[next] = 1;
+      tasks_taken++;
+      if(!quiet)
+        printf("compiling %s... [%d/%d]\n", tasks[next].name.c_str(), tasks_taken, (int) tasks.size());
+      lock.unlock();
+      int res = run_task(tasks[next]);
+      lock.lock();
+      state[next] = 2;
+      if(res) failed = true;
+      cv.notify_all();
+      }
+    };
+
+  vector<thread> threads;
+  for(int i=0; i<batch_size; i++) threads.emplace_back(worker);
+  for(auto& th: threads) th.join();
+  return !failed;
+  }
 
 string obj_dir = "mymake_files";
 string setdir = "../";
 
+/* the directory for the generated sources (hyper.cpp and the unity chunks); usually obj_dir */
+string gen_dir;
+
+bool use_pch = false;
+bool use_hash = true;
+
+int unity_chunks = 0;
+
+/* for the unity chunks, the modules included */
+map<string, vector<string>> unity_parts;
+
+/* split the given modules into unity_chunks chunks, keeping their order; returns the names of the chunks */
+vector<string> make_unity_chunks(const vector<string>& core) {
+  int N = core.size();
+  vector<long long> lines(N);
+  for(int i=0; i<N; i++) {
+    string s = read_file(core[i] + ".cpp");
+    lines[i] = count(s.begin(), s.end(), '\n');
+    }
+  vector<int> order(N);
+  for(int i=0; i<N; i++) order[i] = i;
+  stable_sort(order.begin(), order.end(), [&] (int a, int b) { return lines[a] > lines[b]; });
+
+  /* the largest remaining file goes to the smallest chunk */
+  vector<long long> load(unity_chunks, 0);
+  vector<int> chunk_of(N);
+  for(int i: order) {
+    int best = min_element(load.begin(), load.end()) - load.begin();
+    chunk_of[i] = best;
+    load[best] += lines[i];
+    }
+
+  vector<string> res;
+  for(int k=0; k<unity_chunks; k++) {
+    string name = "unity" + to_string(k);
+    string content = "#include \"" + setdir + "hyper.h\"\n";
+    auto& parts = unity_parts[name];
+    for(int i=0; i<N; i++) if(chunk_of[i] == k) {
+      content += "#include \"" + setdir + core[i] + ".cpp\"\n";
+      parts.push_back(core[i] + ".cpp");
+      }
+    if(parts.empty()) { unity_parts.erase(name); continue; }
+    string fname = gen_dir + "/" + name + ".cpp";
+    /* do not change the timestamp if the chunk is the same */
+    if(read_file(fname) != content) ofstream(fname) << content;
+    res.push_back(name);
+    }
+  return res;
+  }
+
+/* the directory with the profiles, in -pgo-use */
+string pgo_gen_dir;
+
+string module_source(const string& m) {
+  return unity_parts.count(m) ? gen_dir + "/" + m + ".cpp" : m + ".cpp";
+  }
+
+/* copy the profiles from pgo_gen_dir to obj_dir */
+void copy_profiles() {
+  DIR *d = opendir(pgo_gen_dir.c_str());
+  if(!d) { printf("no profile found in %s\n", pgo_gen_dir.c_str()); return; }
+  while(dirent *e = readdir(d)) {
+    string name = e->d_name;
+    if(name.size() < 5 || name.substr(name.size() - 5) != ".gcda") continue;
+    string from = pgo_gen_dir + "/" + name, to = obj_dir + "/" + name;
+    if(get_file_time(from) > get_file_time(to))
+      ofstream(to, ios::binary) << read_file(from);
+    }
+  closedir(d);
+  }
+
+int optimized = 0;
+
 int main(int argc, char **argv) {
   set_os(os);
   int retval = 0; // for storing return values of some function calls
@@ -206,6 +415,30 @@ int main(int argc, char **argv) {
     else if(s == "-q") {
       quiet = true;
       }
+    else if(s == "-pch") {
+      use_pch = true;
+      }
+    else if(s == "-nohash") {
+      use_hash = false;
+      }
+    else if(s == "-unity") {
+      unity_chunks = stoi(argv[i+1]);
+      i++;
+      obj_dir += "/unity" + to_string(unity_chunks);
+      setdir += "../";
+      }
+    else if(s == "-pgo-gen") {
+      compiler += " -fprofile-generate";
+      linker += " -fprofile-generate";
+      obj_dir += "/pgo-gen";
+      setdir += "../";
+      }
+    else if(s == "-pgo-use") {
+      pgo_gen_dir = obj_dir + "/pgo-gen";
+      compiler += " -fprofile-use -fprofile-correction -Wno-missing-profile -Wno-error=coverage-mismatch";
+      obj_dir += "/pgo-use";
+      setdir += "../";
+      }
     else if(s == "-mingw64") {
       set_os("mingw64");
       obj_dir += "/mingw64";
@@ -338,7 +571,15 @@ int main(int argc, char **argv) {
   retval = mysystem("mkdir -p " + obj_dir);
   if (retval) { printf("unable to create output directory!\n"); exit(retval); }
 
-  ofstream fsm(obj_dir + "/hyper.cpp");
+  if(pgo_gen_dir != "") {
+    /* the profile refers to the generated sources, so use the ones from -pgo-gen */
+    gen_dir = pgo_gen_dir;
+    retval = mysystem("mkdir -p " + gen_dir);
+    if (retval) { printf("unable to create output directory!\n"); exit(retval); }
+    }
+  else gen_dir = obj_dir;
+
+  ofstream fsm(gen_dir + "/hyper.cpp");
   fsm << "#if REM\n#define INCLUDE(x)\n#endif\n";
   string s;
   while(getline(fs, s)) {
@@ -358,34 +599,73 @@ int main(int argc, char **argv) {
   fsm.close();
   
   if(!quiet) printf("preprocessing...\n");
-  if(mysystem(preprocessor + " " + opts + " "+obj_dir+"/hyper.cpp -o "+obj_dir+"/hyper.E")) { printf("preprocessing error\n"); exit(1); }
+  if(mysystem(preprocessor + " " + opts + " "+gen_dir+"/hyper.cpp -o "+obj_dir+"/hyper.E")) { printf("preprocessing error\n"); exit(1); }
   
   if(true) {
+    vector<string> core;
     ifstream fs2(obj_dir+"/hyper.E");
     while(getline(fs2, s)) {
       if(s.substr(0, 7) == "INCLUDE") {
         s = s.substr(9);
         s = s.substr(0,s.size() - 2);
-        modules.push_back(s);
+        core.push_back(s);
         }
       }
+    if(unity_chunks > 0) core = make_unity_chunks(core);
+    for(auto& m: core) modules.push_back(m);
     }
+
+  if(pgo_gen_dir != "") copy_profiles();
   
   if(sdlver) modules.push_back("savepng");
 
-  if(get_file_time(obj_dir + "/hyper.o") < get_file_time("hyper.cpp")) {
+  /* in -pgo-use, an object also has to be rebuilt if its profile is newer */
+  auto profile_time = [] (const string& obj) -> time_t {
+    if(pgo_gen_dir == "") return 0;
+    return get_file_time(obj.substr(0, obj.size() - 2) + ".gcda");
+    };
+
+  if(get_file_time(obj_dir + "/hyper.o") < max(get_file_time("hyper.cpp"), profile_time(obj_dir + "/hyper.o"))) {
     if(!quiet) printf("compiling hyper...\n");
-    if(mysystem(compiler + " -DREM " + opts + " " + obj_dir + "/hyper.cpp -c -o " + obj_dir + "/hyper.o")) { printf("error\n"); exit(1); }
+    if(mysystem(compiler + " -DREM " + opts + " " + gen_dir + "/hyper.cpp -c -o " + obj_dir + "/hyper.o")) { printf("error\n"); exit(1); }
     }
   
   string allobj = " " + obj_dir + "/hyper.o";
 
   printf("compiling modules using batch size of %d:\n", batch_size);
 
-  int id = 0;
-  vector<pair<int, function<int(void)>>> tasks;
+  vector<task> tasks;
+  vector<pair<long long, task>> module_tasks;
+
+  /* precompiled headers, for the headers included first by at least two modules */
+  map<string, int> header_users;
+  map<string, int> pch_task;
+  if(use_pch) for(string m: modules) {
+    string h = first_header(module_source(m));
+    if(h == "hyper.h" || h == "rogueviz/rogueviz.h") header_users[h]++;
+    }
+  for(auto& hu: header_users) if(hu.second >= 2) {
+    string h = hu.first;
+    string h2 = h;
+    for(char& c: h2) if(c == '/') c = '_';
+    string wrapper = obj_dir + "/pch_" + h2;
+    if(!file_exists(wrapper)) ofstream(wrapper) << "#include \"" << setdir << h << "\"\n";
+    pch_task[h] = -1;
+    set<string> seen;
+    if(get_file_time(wrapper + ".gch") < get_header_time(h, seen)) {
+      pch_task[h] = tasks.size();
+      task t;
+      t.name = h + " (precompiled)";
+      t.cmdline = compiler + " " + opts + " -x c++-header " + wrapper + " -o " + wrapper + ".gch";
+      t.obj = wrapper + ".gch";
+      t.dep = -1;
+      tasks.push_back(t);
+      }
+    }
+
   for(string m: modules) {
-    string src = m + ".cpp";
+    bool unity = unity_parts.count(m);
+    string src = module_source(m);
     string m2 = m;
     for(char& c: m2) if(c == '/') c = '_';
     string obj = obj_dir + "/" + m2 + ".o";
@@ -395,50 +675,43 @@ int main(int argc, char **argv) {
       exit(1);
       }
     time_t obj_time = get_file_time(obj);
-    if(src == "language.cpp") {
-      src_time = max(src_time, get_file_time("language-data.cpp"));
+    vector<string> parts = unity ? unity_parts[m] : vector<string>{src};
+    for(auto& part: parts) {
+      src_time = max(src_time, get_file_time(part));
+      if(part == "language.cpp")
+        src_time = max(src_time, get_file_time("language-data.cpp"));
       }
+    src_time = max(src_time, profile_time(obj));
     if(src_time > obj_time) {
-      string cmdline = compiler + " " + opts + " " + src + " -o " + obj;
-      pair<int, function<int(void)>> task(id, [cmdline]() { return mysystem(cmdline); });
-      tasks.push_back(task);
+      task t;
+      t.name = m;
+      t.obj = obj;
+      t.dep = -1;
+      string include;
+      string h = first_header(src);
+      if(pch_task.count(h)) {
+        string h2 = h;
+        for(char& c: h2) if(c == '/') c = '_';
+        include = " -include " + obj_dir + "/pch_" + h2;
+        t.dep = pch_task[h];
+        }
+      t.cmdline = compiler + " " + opts + include + " " + src + " -o " + obj;
+      if(use_hash && obj_time)
+        t.precmd = preprocessor + " " + opts + include + " " + src;
+      /* start with the largest files */
+      module_tasks.emplace_back(-(long long) read_file(src).size(), t);
       }
     else {
       if(!quiet) printf("ok: %s\n", m.c_str());
       }
     allobj += " ";
     allobj += obj;
-    id++;
     }
 
-  chrono::milliseconds quantum(40);
-  vector<future<int>> workers(batch_size);
+  stable_sort(module_tasks.begin(), module_tasks.end(), [] (const pair<long long, task>& a, const pair<long long, task>& b) { return a.first < b.first; });
+  for(auto& mt: module_tasks) tasks.push_back(mt.second);
 
-  int tasks_amt = tasks.size();
-  int tasks_taken = 0, tasks_done = 0;
-  bool finished = tasks.empty();
-
-  while (!finished) {
-  for (auto & worker : workers) {
-    if (worker.valid()) {
-      if (worker.wait_for(chrono::seconds(0)) != future_status::ready) continue;
-      else {
-        int res = worker.get();
-        if (res) { printf("compilation error!\n"); exit(1); }
-        ++tasks_done;
-        }
-      }
-    if (tasks_taken < tasks_amt) {
-      auto task = tasks[tasks_taken];
-      int mid = task.first;
-      function<int(void)> do_work = task.second;
-      if(!quiet)
-        printf("compiling %s... [%d/%d]\n", modules[mid].c_str(), tasks_taken+1, tasks_amt);
-      worker = async(launch::async, do_work);
-      ++tasks_taken;
-      }
-    else if (tasks_done == tasks_amt) { finished = true; break; }
-    } this_thread::sleep_for(quantum); }
+  if(!run_tasks(tasks)) { printf("compilation error!\n"); exit(1); }
 
   if (mingw64) {
     retval = mysystem("windres hyper.rc -O coff -o hyper.res");
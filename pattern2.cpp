@@ -1276,6 +1276,118 @@ EX namespace patterns {
     return getpatterninfo(c, whichPattern, subpattern_flags);
     }
   #endif
+
+  /** \brief index of the existing cells by pattern class (getpatterninfo0(c).id), used by the map editor and texture mode
+   *
+   *  Built by flooding the existing cells of currentmap once; afterwards newCell reports the new cells of the same map
+   *  (note_new_cell), until too many of them accumulate without a query (max_pending). Cells of other maps (e.g. the
+   *  underlying map in product and fake geometries, or other intra spaces) are not included.
+   *  Destroying a cell drops the index (it is rebuilt on the next use); the classes are recomputed when
+   *  whichPattern or subpattern_flags change.
+   */
+  struct pattern_index {
+    bool valid;
+    /** the map whose cells are indexed */
+    hrmap *of_map;
+    ePattern pat;
+    int sub;
+    std::unordered_map<cell*, patterninfo> info;
+    map<int, vector<cell*>> by_class;
+    /** cells created since the index has been built, not yet classified */
+    vector<cell*> pending;
+    /** pending is being classified */
+    bool classifying;
+    };
+
+  pattern_index pindex;
+
+  /** only the patterns which depend on the geometry alone are cached: PAT_DOWN depends on the coastal values,
+   *  and Euclidean PAT_PALACE on the land (eufifty), which may be changed in the map editor */
+  bool pattern_cacheable() {
+    switch(whichPattern) {
+      case PAT_NONE: case PAT_TYPES: case PAT_ZEBRA: case PAT_EMERALD: case PAT_FIELD:
+      case PAT_COLORING: case PAT_SIBLING: case PAT_CHESS: case PAT_SINGLETYPE:
+        return true;
+      case PAT_PALACE:
+        return !meuclid;
+      default:
+        return false;
+      }
+    }
+
+  /** if more cells than this are created before the index is used again, it is dropped rather than updated */
+  static const int max_pending = 100000;
+
+  EX void clear_pattern_index() {
+    pindex.valid = false;
+    pindex.info.clear();
+    pindex.by_class.clear();
+    pindex.pending.clear();
+    }
+
+  EX void note_new_cell(cell *c) {
+    if(!pindex.valid || currentmap != pindex.of_map) return;
+    if(isize(pindex.pending) >= max_pending && !pindex.classifying) clear_pattern_index();
+    else pindex.pending.push_back(c);
+    }
+
+  EX void note_destroyed_cell(cell *c) {
+    if(pindex.valid) clear_pattern_index();
+    else if(!pindex.info.empty()) pindex.info.erase(c);
+    }
+
+  void check_pattern_index() {
+    if(pindex.pat == whichPattern && pindex.sub == subpattern_flags) return;
+    /* the cells stay the same, only their classes change */
+    for(auto& p: pindex.by_class) for(cell *c: p.second) pindex.pending.push_back(c);
+    pindex.by_class.clear();
+    pindex.info.clear();
+    pindex.pat = whichPattern;
+    pindex.sub = subpattern_flags;
+    }
+
+  /** \brief getpatterninfo0(c), cached per cell */
+  EX patterninfo indexed_patterninfo(cell *c) {
+    if(!pattern_cacheable()) return getpatterninfo0(c);
+    check_pattern_index();
+    auto it = pindex.info.find(c);
+    if(it != pindex.info.end()) return it->second;
+    return pindex.info[c] = getpatterninfo0(c);
+    }
+
+  /** \brief all the existing cells (reachable from 'from') such that getpatterninfo0(c).id == id
+   *  When indexed, these are the cells reachable when the index was built, and the cells created in the same map since.
+   */
+  EX const vector<cell*>& cells_in_class(cell *from, int id) {
+    static vector<cell*> res;
+    if(pindex.valid && pindex.of_map != currentmap) clear_pattern_index();
+    if(!pattern_cacheable() || !pindex.valid) {
+      manual_celllister cl;
+      cl.add(from);
+      for(int i=0; i<isize(cl.lst); i++) forCellEx(c3, cl.lst[i]) cl.add(c3);
+      if(!pattern_cacheable()) {
+        res.clear();
+        for(cell *c: cl.lst) if(getpatterninfo0(c).id == id) res.push_back(c);
+        return res;
+        }
+      check_pattern_index();
+      pindex.by_class.clear();
+      pindex.pending = cl.lst;
+      pindex.of_map = currentmap;
+      pindex.valid = true;
+      }
+    check_pattern_index();
+    /* classifying may create new cells (PAT_PALACE looks at all the neighbors), so pending may grow here */
+    dynamicval<bool> cl(pindex.classifying, true);
+    for(int i=0; i<isize(pindex.pending); i++) {
+      cell *c = pindex.pending[i];
+      pindex.by_class[indexed_patterninfo(c).id].push_back(c);
+      }
+    pindex.pending.clear();
+    return pindex.by_class[id];
+    }
+
+  auto ah_pindex = addHook(hooks_clearmemory, 100, clear_pattern_index);
   
   EX }
 
@@ -1676,92 +1788,136 @@ EX namespace patterns {
     }
   
 
-  cld compute_map_function(cell *c, int p, const string& formula) {
-    exp_parser ep;
-    ep.extra_params["p"] = p;
+  /** the cell being evaluated, together with lazily computed values shared by several variables */
+  struct map_function_context {
+    cell *c;
+    bool have_h;
+    hyperpoint h;
+    map_function_context(cell *_c) : c(_c), have_h(false) {}
+    hyperpoint& get_h() {
+      if(!have_h) h = calc_relative_matrix(c, currentmap->gamestart(), C0) * C0, have_h = true;
+      return h;
+      }
+    };
 
-    hyperpoint h = calc_relative_matrix(c, currentmap->gamestart(), C0) * C0;
-    ep.extra_params["x"] = h[0];
-    ep.extra_params["y"] = h[1];
-    ep.extra_params["z"] = h[2];
+  /** a cell property available as a variable in map function formulas */
+  struct map_function_variable {
+    string name;
+    /** is it defined in the current geometry? formulas using undefined variables evaluate to 0 */
+    std::function<bool()> available;
+    std::function<cld(map_function_context&)> get;
+    };
+
+  /** a map function formula compiled for repeated evaluation */
+  struct compiled_map_function {
+    string formula;
+    /** did the compilation succeed? */
+    bool ok;
+    compiled_exp code;
+    /** indices of map_function_variables used by the formula */
+    vector<int> needed;
+    };
+
+  static bool always() { return true; }
+
+  vector<map_function_variable>& map_function_variables() {
+    static vector<map_function_variable> vars;
+    if(!vars.empty()) return vars;
+    auto add = [] (const string& name, const std::function<bool()>& available, const std::function<cld(map_function_context&)>& get) {
+      vars.push_back(map_function_variable{name, available, get});
+      };
+    auto addc = [&add] (const string& name, const std::function<bool()>& available, const std::function<cld(cell*)>& get) {
+      add(name, available, [get] (map_function_context& ctx) { return get(ctx.c); });
+      };
+    add("p", always, [] (map_function_context&) { return cld(0); });
+    add("x", always, [] (map_function_context& ctx) { return cld(ctx.get_h()[0]); });
+    add("y", always, [] (map_function_context& ctx) { return cld(ctx.get_h()[1]); });
+    add("z", always, [] (map_function_context& ctx) { return cld(ctx.get_h()[2]); });
     #if MAXMDIM >= 4
-    ep.extra_params["w"] = h[3];
+    add("w", always, [] (map_function_context& ctx) { return cld(ctx.get_h()[3]); });
     #endif
-    ep.extra_params["z40"] = zebra40(c);
-    ep.extra_params["z3"] = zebra3(c);
-    ep.extra_params["ev"] = emeraldval(c);
-    ep.extra_params["fv50"] = fiftyval(c);
-    ep.extra_params["pa"] = polara50(c);
-    ep.extra_params["pb"] = polarb50(c);
-    ep.extra_params["pd"] = cdist50(c);
-    ep.extra_params["fu"] = fieldpattern::fieldval_uniq(c);
-    ep.extra_params["threecolor"] = pattern_threecolor(c);
-    ep.extra_params["chess"] = chessvalue(c);
-    ep.extra_params["ph"] = pseudohept(c);
-    ep.extra_params["kph"] = kraken_pseudohept(c);
-    if(true) {
-      ep.extra_params["md"] = c->master->distance;
-      ep.extra_params["me"] = c->master->emeraldval;
-      ep.extra_params["mf"] = c->master->fieldval;
-      ep.extra_params["mz"] = c->master->zebraval;
-      }
-
-    if(msphere) {
-      ep.extra_params["h0"] = getHemisphere(c, 0);
-      ep.extra_params["h1"] = getHemisphere(c, 1);
-      ep.extra_params["h2"] = getHemisphere(c, 2);
-      }
-    if(euclid) {
-      auto co = euc2_coordinates(c);
-      int x = co.first, y = co.second;
-      ep.extra_params["ex"] = x;
-      ep.extra_params["ey"] = y;
-      if(S7 == 6) ep.extra_params["ez"] = -x-y;
-      }
+    addc("z40", always, [] (cell *c) { return zebra40(c); });
+    addc("z3", always, [] (cell *c) { return zebra3(c); });
+    addc("ev", always, [] (cell *c) { return emeraldval(c); });
+    addc("fv50", always, [] (cell *c) { return fiftyval(c); });
+    addc("pa", always, [] (cell *c) { return polara50(c); });
+    addc("pb", always, [] (cell *c) { return polarb50(c); });
+    addc("pd", always, [] (cell *c) { return cdist50(c); });
+    addc("fu", always, [] (cell *c) { return fieldpattern::fieldval_uniq(c); });
+    addc("threecolor", always, [] (cell *c) { return pattern_threecolor(c); });
+    addc("chess", always, [] (cell *c) { return chessvalue(c); });
+    addc("ph", always, [] (cell *c) { return pseudohept(c); });
+    addc("kph", always, [] (cell *c) { return kraken_pseudohept(c); });
+    addc("md", always, [] (cell *c) { return c->master->distance; });
+    addc("me", always, [] (cell *c) { return c->master->emeraldval; });
+    addc("mf", always, [] (cell *c) { return c->master->fieldval; });
+    addc("mz", always, [] (cell *c) { return c->master->zebraval; });
+    for(int i=0; i<3; i++)
+      addc("h" + its(i), [] { return msphere; }, [i] (cell *c) { return getHemisphere(c, i); });
+    addc("ex", [] { return euclid; }, [] (cell *c) { return euc2_coordinates(c).first; });
+    addc("ey", [] { return euclid; }, [] (cell *c) { return euc2_coordinates(c).second; });
+    addc("ez", [] { return euclid && S7 == 6; }, [] (cell *c) { auto co = euc2_coordinates(c); return -co.first-co.second; });
     #if CAP_CRYSTAL
-    if(cryst) {
-      crystal::ldcoord co = crystal::get_ldcoord(c);
-      for(int i=0; i<crystal::MAXDIM; i++)
-        ep.extra_params["x"+its(i)] = co[i];
-      }
+    for(int i=0; i<crystal::MAXDIM; i++)
+      addc("x" + its(i), [] { return cryst; }, [i] (cell *c) { return crystal::get_ldcoord(c)[i]; });
     #endif
     #if CAP_SOLV
-    if(asonov::in()) {
-      auto co = asonov::get_coord(c->master);
-      ep.extra_params["ax"] = szgmod(co[0], asonov::period_xy);
-      ep.extra_params["ay"] = szgmod(co[1], asonov::period_xy);
-      ep.extra_params["az"] = szgmod(co[2], asonov::period_z);      
-      }
+    addc("ax", [] { return asonov::in(); }, [] (cell *c) { return szgmod(asonov::get_coord(c->master)[0], asonov::period_xy); });
+    addc("ay", [] { return asonov::in(); }, [] (cell *c) { return szgmod(asonov::get_coord(c->master)[1], asonov::period_xy); });
+    addc("az", [] { return asonov::in(); }, [] (cell *c) { return szgmod(asonov::get_coord(c->master)[2], asonov::period_z); });
     #endif
-    if(nil) {
-      auto co = nilv::get_coord(c->master);
-      ep.extra_params["nx"] = szgmod(co[0], nilv::nilperiod[0]);
-      ep.extra_params["ny"] = szgmod(co[1], nilv::nilperiod[1]);
-      ep.extra_params["nz"] = szgmod(co[2], nilv::nilperiod[2]);      
-      }
-    if(mhybrid)
-      ep.extra_params["level"] = hybrid::get_where(c).second;
-
-    if(geometry_supports_cdata()) {
-      ep.extra_params["d0"] = getCdata(c, 0);
-      ep.extra_params["d1"] = getCdata(c, 1);
-      ep.extra_params["d2"] = getCdata(c, 2);
-      ep.extra_params["d3"] = getCdata(c, 3);
-      }
-        
-    ep.s = formula;
+    for(int i=0; i<3; i++)
+      addc(string("n") + "xyz"[i], [] { return nil; }, [i] (cell *c) { return szgmod(nilv::get_coord(c->master)[i], nilv::nilperiod[i]); });
+    addc("level", [] { return mhybrid; }, [] (cell *c) { return hybrid::get_where(c).second; });
+    for(int i=0; i<4; i++)
+      addc("d" + its(i), geometry_supports_cdata, [i] (cell *c) { return getCdata(c, i); });
+    return vars;
+    }
+
+  compiled_map_function current_map_function = {"", false, compiled_exp(), {}};
+
+  /** compile the formula, reusing the previous result if the formula has not changed; a formula which has failed to compile is tried again */
+  compiled_map_function& compile_map_function(const string& formula) {
+    auto& cmf = current_map_function;
+    if(cmf.ok && cmf.formula == formula) return cmf;
+    auto& vars = map_function_variables();
+    vector<string> names;
+    for(auto& v: vars) names.push_back(v.name);
+    cmf.formula = formula;
+    cmf.needed.clear();
     try {
-      return ep.parse();
+      cmf.code = compile_exp(formula, names);
+      cmf.ok = true;
       }
     catch(hr_parse_exception&) {
-      return 0;
+      cmf.code = compiled_exp();
+      cmf.ok = false;
+      return cmf;
       }
+    /* 'p' (slot 0) is set per channel rather than computed */
+    for(int i=1; i<isize(vars); i++) if(cmf.code.used[i]) cmf.needed.push_back(i);
+    return cmf;
     }
-  
-  EX color_t compute_cell_color(cell *c) {
+
+  /** prepare the frame for evaluating cmf at c; returns false if the formula uses a variable not available here */
+  bool prepare_map_frame(compiled_map_function& cmf, cell *c, vector<cld>& frame) {
+    auto& vars = map_function_variables();
+    frame.resize(cmf.code.frame_size);
+    map_function_context ctx(c);
+    for(int i: cmf.needed) {
+      if(!vars[i].available()) return false;
+      frame[i] = vars[i].get(ctx);
+      }
+    return true;
+    }
+
+  color_t map_color_from_frame(compiled_map_function& cmf, vector<cld>& frame) {
     color_t res;
     for(int i=0; i<4; i++) {
-      ld v = real(compute_map_function(c, 1+i, color_formula));
+      frame[0] = 1+i;
+      ld v;
+      try { v = real(cmf.code(&frame[0])); }
+      catch(hr_parse_exception&) { v = 0; }
       if(i == 3) part(res, i) = (v > 0);
       else if(v < 0) part(res, i) = 0;
       else if(v > 1) part(res, i) = 255;
@@ -1770,6 +1926,25 @@ EX namespace patterns {
     return res;
     }
 
+  EX color_t compute_cell_color(cell *c) {
+    auto& cmf = compile_map_function(color_formula);
+    vector<cld> frame;
+    if(!cmf.ok || !prepare_map_frame(cmf, c, frame)) return 0;
+    return map_color_from_frame(cmf, frame);
+    }
+
+  /** compute_cell_color(c) for each c in cells, in order; only the formula lookup and the frame are shared */
+  EX vector<color_t> compute_cell_color_each(const vector<cell*>& cells) {
+    vector<color_t> res(isize(cells), 0);
+    auto& cmf = compile_map_function(color_formula);
+    if(!cmf.ok) return res;
+    vector<cld> frame;
+    for(int i=0; i<isize(cells); i++)
+      if(prepare_map_frame(cmf, cells[i], frame))
+        res[i] = map_color_from_frame(cmf, frame);
+    return res;
+    }
+
   EX hookset<int(cell*)> hooks_generate_canvas;
 
   EX color_t apeirogonal_color = 0xFFFFFFFF;
@@ -2151,7 +2326,7 @@ EX namespace patterns {
           "wallif(condition, color)\n"
           );
         
-        s += XLAT("see compute_map_function in pattern2.cpp for more\n");
+        s += XLAT("see map_function_variables in pattern2.cpp for more\n");
         
         dialog::edit_string(color_formula, "formula", s);
 
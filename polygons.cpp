@@ -870,7 +870,7 @@ vector<ld> equal_weights(1000, 1);
 void geometry_information::make_wall(int id, vector<hyperpoint> vertices, vector<ld> weights) { }
 void geometry_information::reserve_wall3d(int i) { }
 void geometry_information::create_wall3d() { }
-void geometry_information::compute_cornerbonus() { }
+void geometry_information::compute_cornerbonus(int from) { }
 #endif
 
 #if MAXMDIM >= 4
@@ -1056,10 +1056,13 @@ void geometry_information::create_wall3d() {
   compute_cornerbonus();
   }
 
-void geometry_information::compute_cornerbonus() {
-  corner_bonus = 0;
-  for(hpcshape sh: shWall3D) for(int i=sh.s; i<sh.e; i++)
-    corner_bonus = max(corner_bonus, hdist0(hpc[i]));
+void geometry_information::compute_cornerbonus(int from) {
+  if(from == 0) corner_bonus = 0;
+  for(int id=from; id<isize(shWall3D); id++) {
+    auto& sh = shWall3D[id];
+    for(int i=sh.s; i<sh.e; i++)
+      corner_bonus = max(corner_bonus, hdist0(hpc[i]));
+    }
   if(cgflags & qIDEAL) corner_bonus = 3;
   }
 #endif
@@ -43,6 +43,14 @@ struct code {
 
   };
 
+struct code_hash {
+  size_t operator() (const code& c) const {
+    size_t h = 0;
+    for(int v: c.connections) h = h * 1000003 + v;
+    return h;
+    }
+  };
+
 struct hrmap_quotient : hrmap_standard {
 
   hrmap_hyperbolic base;
@@ -51,7 +59,7 @@ struct hrmap_quotient : hrmap_standard {
   
   cell *origin;
   
-  map<quotientspace::code, int> reachable;
+  std::unordered_map<quotientspace::code, int, code_hash> reachable;
   vector<heptspin> bfsq;
   
   vector<int> connections;
@@ -41,7 +41,12 @@ struct race_cellinfo {
 
 vector<race_cellinfo> rti;
 EX vector<cell*> track;
-map<cell*, int> rti_id;
+/** the index in rti of each cell near the track; a flat open-addressing table, since get_info is called every frame */
+cell_index_map rti_id;
+
+/** track_rel[dir][at] is the relative matrix from track[at] to the far track cell used by track_matrix, computed lazily */
+array<vector<transmatrix>, 2> track_rel;
+array<vector<bool>, 2> track_rel_known;
 
 EX int trophy[MAXPLAYER];
 
@@ -51,7 +56,9 @@ int race_try;
 
 EX int race_start_tick, race_finish_tick[MAXPLAYER];
 
+#if HDR
 typedef unsigned char uchar;
+#endif
 
 uchar frac_to_uchar(ld x) { return uchar(x * 256); }
 uchar angle_to_uchar(ld x) { return frac_to_uchar(x / TAU); }
@@ -61,29 +68,148 @@ transmatrix spin_uchar(uchar x) { return spin(uchar_to_frac(x) * TAU); }
 
 static const ld distance_multiplier = 4;
 
+#if HDR
 struct ghostmoment {
   int step;
   cell *where_cell;
   uchar alpha, distance, beta, footphase;
   };
 
+/** the part of a ghost history which has not been decoded yet (see encode_history) */
+struct ghost_stream {
+  string data;
+  int pos;
+  vector<cell*> jumps;
+  int next_jump;
+  int delta;
+  int left;
+  };
+
 struct ghost {
   charstyle cs;
   int result;
   int checksum;
   long long timestamp;
   vector<ghostmoment> history;
+  ghost_stream stream;
   };
+#endif
 
 vector<ghost> ghostset;
 
-array<vector<ghostmoment>, MAXPLAYER> current_history;
+EX array<vector<ghostmoment>, MAXPLAYER> current_history;
 
 EX map<eLand, int> best_scores;
 EX map<eLand, int> best_scores_to_save;
 
 string ghost_prefix = "default";
 
+/* Compact encoding of ghost histories. Every moment is a header byte followed by the changed data:
+ * bits 0-3: alpha, distance, beta, footphase changed;
+ * bit 4: moved to a neighbor cell (direction byte follows);
+ * bit 5: jumped to the next cell in the jump list;
+ * bit 6: the step delta changed (zigzag varint of the change follows);
+ * bit 7: the changed uchars are given as 4-bit deltas, two per byte, rather than full bytes.
+ */
+
+static void put_varint(string& s, int v) {
+  unsigned u = (unsigned(v) << 1) ^ unsigned(v >> 31);
+  while(u >= 128) s += char(128 | (u & 127)), u >>= 7;
+  s += char(u);
+  }
+
+static uchar next_byte(ghost_stream& s) {
+  if(s.pos >= isize(s.data)) { s.left = 0; return 0; }
+  return s.data[s.pos++];
+  }
+
+static int get_varint(ghost_stream& s) {
+  unsigned u = 0;
+  for(int sh=0; sh<32; sh+=7) {
+    uchar b = next_byte(s);
+    u |= unsigned(b & 127) << sh;
+    if(!(b & 128)) break;
+    }
+  return int(u >> 1) ^ -int(u & 1);
+  }
+
+static const ghostmoment no_moment = {0, nullptr, 0, 0, 0, 0};
+
+/** encode h, returning the cells which are not reached by a single move in jumps */
+EX string encode_history(const vector<ghostmoment>& h, vector<cell*>& jumps) {
+  string s;
+  ghostmoment prev = no_moment;
+  int delta = 0;
+  for(auto& m: h) {
+    uchar header = 0;
+    string extra;
+    int d = m.step - prev.step;
+    if(d != delta) header |= 64, put_varint(extra, d - delta), delta = d;
+    if(m.where_cell != prev.where_cell) {
+      int dir = prev.where_cell ? neighborId(prev.where_cell, m.where_cell) : -1;
+      if(dir >= 0 && dir < 256) header |= 16, extra += char(dir);
+      else header |= 32, jumps.push_back(m.where_cell);
+      }
+    uchar cur[4] = {m.alpha, m.distance, m.beta, m.footphase};
+    uchar old[4] = {prev.alpha, prev.distance, prev.beta, prev.footphase};
+    vector<int> diffs;
+    bool small = true;
+    for(int i=0; i<4; i++) if(cur[i] != old[i]) {
+      header |= 1<<i;
+      int df = (signed char) uchar(cur[i] - old[i]);
+      diffs.push_back(df);
+      if(df < -8 || df > 7) small = false;
+      }
+    if(small && isize(diffs)) {
+      header |= 128;
+      for(int i=0; i<isize(diffs); i+=2)
+        extra += char((diffs[i] & 15) | ((i+1 < isize(diffs) ? diffs[i+1] & 15 : 0) << 4));
+      }
+    else for(int i=0; i<4; i++) if(header & (1<<i)) extra += char(cur[i]);
+    s += char(header);
+    s += extra;
+    prev = m;
+    }
+  return s;
+  }
+
+/** decode (at most) qty further moments of gh; a corrupt stream just ends the history */
+EX void decode_moments(ghost& gh, int qty) {
+  auto& s = gh.stream;
+  while(qty-- > 0 && s.left > 0) {
+    ghostmoment m = gh.history.empty() ? no_moment : gh.history.back();
+    uchar header = next_byte(s);
+    if(header & 64) s.delta += get_varint(s);
+    m.step += s.delta;
+    if(header & 16) {
+      int dir = next_byte(s);
+      m.where_cell = m.where_cell && dir < m.where_cell->type ? m.where_cell->cmove(dir) : nullptr;
+      }
+    if(header & 32) m.where_cell = s.next_jump < isize(s.jumps) ? s.jumps[s.next_jump++] : nullptr;
+    uchar *f[4] = {&m.alpha, &m.distance, &m.beta, &m.footphase};
+    if(header & 128) {
+      int q = 0, b = 0;
+      for(int i=0; i<4; i++) if(header & (1<<i)) {
+        if(!(q & 1)) b = next_byte(s);
+        int df = (b >> (4 * (q & 1))) & 15;
+        *f[i] += uchar(df >= 8 ? df - 16 : df);
+        q++;
+        }
+      }
+    else for(int i=0; i<4; i++) if(header & (1<<i)) *f[i] = next_byte(s);
+    if(!m.where_cell || s.left == 0) { s.left = 0; break; }
+    gh.history.push_back(m);
+    s.left--;
+    }
+  if(s.left <= 0) { s.data = ""; s.jumps.clear(); }
+  }
+
+/** make sure that the history is decoded up to the first moment after t */
+void decode_until(ghost& gh, int t) {
+  while(gh.stream.left > 0 && (gh.history.empty() || gh.history.back().step <= t))
+    decode_moments(gh, 256);
+  }
+
 #if CAP_FILES && CAP_EDIT
 void hread(hstream& hs, ghostmoment& m) {
   int id;
@@ -91,25 +217,35 @@ void hread(hstream& hs, ghostmoment& m) {
   m.where_cell = mapstream::cellbyid[id];
   }
 
-void hwrite(hstream& hs, const ghostmoment& m) {
-  int id = mapstream::cellids[m.where_cell];
-  hwrite(hs, m.step, id, m.alpha, m.distance, m.beta, m.footphase);
-  }
-
+/** the format used before the compact encoding */
 void hread(hstream& hs, ghost& gh) {
   hread(hs, gh.cs, gh.result, gh.timestamp, gh.checksum, gh.history);
   }
 
-void hwrite(hstream& hs, const ghost& gh) {
-  hwrite(hs, gh.cs, gh.result, gh.timestamp, gh.checksum, gh.history);
-  }
-
 EX void save_ghosts(hstream& f) {
-  hwrite(f, ghostset);
+  hwrite<int>(f, isize(ghostset));
+  for(auto& gh: ghostset) {
+    decode_until(gh, INT_MAX);
+    vector<cell*> jumps;
+    string data = encode_history(gh.history, jumps);
+    vector<int> ids;
+    for(cell *c: jumps) ids.push_back(mapstream::cellids[c]);
+    hwrite(f, gh.cs, gh.result, gh.timestamp, gh.checksum, ids, isize(gh.history), data);
+    }
   }
 
 EX void load_ghosts(hstream& f) {
-  hread(f, ghostset);
+  int qty = f.get<int>();
+  /* the compact encoding is used since 0xA929 */
+  bool compact = f.get_vernum() >= 0xA929;
+  ghostset.clear();
+  ghostset.resize(qty);
+  for(auto& gh: ghostset) {
+    if(!compact) { hread(f, gh); continue; }
+    vector<int> ids;
+    hread(f, gh.cs, gh.result, gh.timestamp, gh.checksum, ids, gh.stream.left, gh.stream.data);
+    for(int id: ids) gh.stream.jumps.push_back(id >= 0 && id < isize(mapstream::cellbyid) ? mapstream::cellbyid[id] : nullptr);
+    }
   }
 
 #endif
@@ -177,12 +313,14 @@ int trackval(cell *c) {
   }
 
 void tie_info(cell *c, int from_track, int comp) {
-  rti_id[c] = isize(rti);
+  rti_id.insert(c, isize(rti));
   rti.emplace_back(race_cellinfo{c, from_track, comp, -1, -1});
   }
 
 race_cellinfo& get_info(cell *c) {
-  return rti[rti_id.at(c)];
+  int id = rti_id.find(c);
+  if(id < 0) throw hr_exception("racing: cell not near the track");
+  return rti[id];
   }
 
 ld start_line_width;
@@ -198,7 +336,7 @@ void find_track(cell *start, int sign, int len) {
   dl = (8 + dl) / 2;
   if(WDIM == 3 && dl < 6) dl = 6;
   cell *goal;
-  map<cell*, cell*> parent;
+  std::unordered_map<cell*, cell*> parent;
   map<int, vector<cell*> > cellbydist;
   cellbydist[0].push_back(start);
     
@@ -341,7 +479,8 @@ EX void make_bounded_track(cell *s) {
     if(c->land != laAsteroids) c->wall = waNone;
     }
 
-  map<cell*, int> mazetype;
+  std::unordered_map<cell*, int> mazetype;
+  vector<cell*> to_block;
   track.clear();
   track.push_back(s);
   while(true) {
@@ -354,13 +493,9 @@ EX void make_bounded_track(cell *s) {
       }
     if(choices.empty()) break;
     cell *nxt = choices[hrand(isize(choices))];
-    for(cell *cc: choices) mazetype[cc] = 2;
+    for(cell *cc: choices) if(cc != nxt) mazetype[cc] = 2, to_block.push_back(cc);
     track.push_back(nxt);
     }
-  vector<cell*> to_block;
-  for(auto p: mazetype) {
-    if(p.second == 2) to_block.push_back(p.first);
-    }
   block_cells(to_block, [] (cell *c) { return true; });
   for(cell *c: to_block) if(among(c->wall, waNone, waInvisibleFloor) && !c->monst) c->wall = waBarrier;
   }
@@ -477,6 +612,8 @@ EX void configure_track(bool gen) {
     
     rti.clear();
     rti_id.clear();
+    for(auto& tr: track_rel) tr.clear();
+    for(auto& tk: track_rel_known) tk.assign(isize(track), false);
   
     for(int i=0; i<isize(track); i++) {
       tie_info(track[i], 0, i);
@@ -488,7 +625,7 @@ EX void configure_track(bool gen) {
     for(int i=0; i<isize(cl.lst); i++) {
       cell *c = cl.lst[i];
       auto p = get_info(c);
-      forCellEx(c2, c) if(!rti_id.count(c2)) {
+      forCellEx(c2, c) if(rti_id.find(c2) < 0) {
         tie_info(c2, p.from_track+1, p.completion);
         cl.add(c2);
         }
@@ -551,7 +688,7 @@ EX void configure_track(bool gen) {
     hyperpoint h = straight * parabolic1(a) * C0;
     cell *at = s;
     virtualRebase(at, h);
-    if(!rti_id.count(at)) break;
+    if(rti_id.find(at) < 0) break;
     if(at->land == laMemory) break;
     }
   
@@ -595,7 +732,6 @@ EX void configure_track(bool gen) {
     }
   
   if(1) {
-    map<cell*, pair<int, int> > cdists;
     manual_celllister cl;
     cl.add(s);
     for(auto cc: rti) if(cc.from_start == 0) cl.add(cc.c);
@@ -611,7 +747,6 @@ EX void configure_track(bool gen) {
     }
 
   if(1) {
-    map<cell*, pair<int, int> > cdists;
     manual_celllister cl;
     for(auto cc: rti) if(among(cc.c->wall, waCloud, waMirror))
       cc.from_goal = 0, cl.add(cc.c);
@@ -666,6 +801,10 @@ EX void reset_race() {
   
   cell *s = track[0];
 
+  /* a truncated or corrupt stream may decode to no moments at all; such ghosts are dropped */
+  for(auto& ghost: ghostset) decode_until(ghost, INT_MIN);
+  ghostset.erase(std::remove_if(ghostset.begin(), ghostset.end(), [] (const ghost& gh) { return gh.history.empty(); }), ghostset.end());
+
   vector<shiftmatrix> forbidden;
   for(auto& ghost: ghostset)
     forbidden.push_back(get_ghostmoment_matrix(ghost.history[0]));
@@ -708,8 +847,9 @@ EX bool use_standard_centering() {
   return standard_centering || force_standard_centering();
   }
 
-EX transmatrix track_matrix(int at, int dir) {
-  transmatrix res = unshift(ggmatrix(racing::track[at]));
+/** follow the track from track[at] in the direction dir, until it ends, breaks, or the relative matrix gets too large */
+transmatrix compute_track_rel(int at, int dir) {
+  transmatrix res = Id;
   while(true) {
     if(at+dir < 0 || at+dir >= isize(racing::track)) return res;
     for(int x=0; x<MXDIM; x++) for(int y=0; y<MXDIM; y++)
@@ -723,6 +863,16 @@ EX transmatrix track_matrix(int at, int dir) {
     }
   }
 
+EX transmatrix track_matrix(int at, int dir) {
+  int di = dir > 0;
+  auto& known = track_rel_known[di];
+  auto& rel = track_rel[di];
+  if(isize(known) != isize(track)) known.assign(isize(track), false);
+  if(isize(rel) != isize(track)) rel.resize(isize(track));
+  if(!known[at]) rel[at] = compute_track_rel(at, dir), known[at] = true;
+  return unshift(ggmatrix(racing::track[at])) * rel[at];
+  }
+
 EX bool set_view() {
 
   multi::cpid = subscreens::in ? subscreens::current_player : 0;
@@ -841,6 +991,8 @@ auto hook =
     track.clear();
     rti.clear();
     rti_id.clear();
+    for(auto& tr: track_rel) tr.clear();
+    for(auto& tk: track_rel_known) tk.clear();
     reachable_goals.clear();
     for(auto &ch: current_history) ch.clear();
     })
@@ -901,18 +1053,23 @@ EX string racetimeformat(int t) {
 
 extern int playercfg;
 
+/** official tracks, decompressed, so that restarting an official race does not read officials.data again */
+map<eLand, string> official_track_cache;
+
 EX void load_official_track() {
-  fhstream f("officials.data", "rb");
-  hread(f, f.vernum);
-  map<eLand, string> tracks;
-  hread(f, tracks);
   eLand l = specialland;
-  if(!tracks.count(l)) {
-    println(hlog, "ERROR: no official track in the database");
-    throw hstream_exception();
+  if(!official_track_cache.count(l)) {
+    fhstream f("officials.data", "rb");
+    hread(f, f.vernum);
+    map<eLand, string> tracks;
+    hread(f, tracks);
+    if(!tracks.count(l)) {
+      println(hlog, "ERROR: no official track in the database");
+      throw hstream_exception();
+      }
+    official_track_cache[l] = decompress_string(tracks[l]);
     }
-  string s = decompress_string(tracks[l]);
-  shstream sf(s);
+  shstream sf(official_track_cache[l]);
   #if CAP_EDIT
   mapstream::loadMap(sf);
   #endif
@@ -1298,7 +1455,7 @@ EX void race_won() {
       
     if(true) {
       auto &subtrack = ghostset;
-      subtrack.emplace_back(ghost{gcs, result, VERNUM_HEX, time(NULL), current_history[multi::cpid]});
+      subtrack.emplace_back(ghost{gcs, result, VERNUM_HEX, time(NULL), current_history[multi::cpid], ghost_stream()});
       sort(subtrack.begin(), subtrack.end(), [] (const ghost &g1, const ghost &g2) { return g1.result < g2.result; });
       if(isize(subtrack) > ghosts_to_save && ghosts_to_save > 0) 
         subtrack.resize(ghosts_to_save);
@@ -1328,13 +1485,19 @@ void draw_ghost_at(ghost& ghost, cell *w, const shiftmatrix& V, ghostmoment& p)
   drawMonsterType(moPlayer, w, V, 0, uchar_to_frac(p.footphase), NOCOLOR);
   }
 
+/** the first moment after the current time (steps are increasing); the stream is decoded as far as needed */
+vector<ghostmoment>::iterator next_ghostmoment(ghost& ghost) {
+  int t = ticks - race_start_tick;
+  decode_until(ghost, t);
+  return std::upper_bound(ghost.history.begin(), ghost.history.end(), t, [] (int t, const ghostmoment& gm) { return t < gm.step; });
+  }
+
 bool ghost_finished(ghost& ghost) {
-  auto p = std::find_if(ghost.history.begin(), ghost.history.end(), [] (const ghostmoment gm) { return gm.step > ticks - race_start_tick;} );
-  return p == ghost.history.end();
+  return next_ghostmoment(ghost) == ghost.history.end();
   }
 
 ghostmoment& get_ghostmoment(ghost& ghost) {
-  auto p = std::find_if(ghost.history.begin(), ghost.history.end(), [] (const ghostmoment gm) { return gm.step > ticks - race_start_tick;} );
+  auto p = next_ghostmoment(ghost);
   if(p == ghost.history.end()) p--, p->footphase = 0;
   return *p;
   }
@@ -1433,7 +1596,7 @@ EX void markers() {
   }
 
 EX void add_debug(cell *c) { 
-  if(racing::on && racing::rti_id[c]) {
+  if(racing::on && racing::rti_id.find(c) >= 0) {
     auto& r = racing::get_info(c);
     dialog::addSelItem("from_track", its(r.from_track), 0);
     dialog::addSelItem("from_start", its(r.from_start), 0);
@@ -2366,8 +2366,7 @@ struct raycast_map {
           break;
           }
         }
-      intra::resetter ir;
-      intra::may_switch_to(c1);
+      /* does not need to switch to the space of c1 */
       int wo1 = intra::full_wall_offset(c1);
       if(wo1 >= max_wall_offset)
         println(hlog, "error: wall_offset ", wo1, " exceeds ", max_wall_offset);
@@ -33,15 +33,19 @@ void subcellshape::compute_common() {
 
   int N = isize(faces);
 
+  vertex_welder vw(1e-5);
+  vector<vector<int>> face_ids(N);
+  for(int i=0; i<N; i++) for(auto& v: faces[i]) face_ids[i].push_back(vw.weld(v));
+
   dirdist.resize(N);
+  vector<int> in_face(vw.size(), -1);
   for(int i=0; i<N; i++) {
     auto& da = dirdist[i];
     da.resize(N, false);
-    set<unsigned> cface;
-    for(auto& v: faces[i]) cface.insert(bucketer(v));
+    for(int v: face_ids[i]) in_face[v] = i;
     for(int j=0; j<N; j++) {
       int mutual = 0;
-      for(auto& w: faces[j]) if(cface.count(bucketer(w))) mutual++;
+      for(int w: face_ids[j]) if(in_face[w] == i) mutual++;
       da[j] = i == j ? 0 : mutual == 2 ? 1 : INFD;
       }
     }
@@ -825,14 +829,14 @@ EX namespace reg3 {
   void hrmap_closed3::make_subconnections() {
     auto& ss = cgi.subshapes;
 
+    vertex_welder hept_vertices(1e-5);
+    for(auto& v: cgi.heptshape->vertices_only) hept_vertices.weld(v);
+
     auto& vas = vertex_adjacencies;
     vas.resize(isize(allh));
     for(int a=0; a<isize(allh); a++) {
       auto& va = vas[a];
       va.emplace_back(vertex_adjacency_info{a, Id, {}});
-      
-      set<unsigned> buckets;
-      for(auto& v: cgi.heptshape->vertices_only) buckets.insert(bucketer(v));
 
       if(cgflags & qIDEAL) {
         for(int d=0; d<S7; d++) {
@@ -850,7 +854,7 @@ EX namespace reg3 {
 
           bool found_va = false;
           for(auto& w: cgi.heptshape->vertices_only)
-            if(buckets.count(bucketer(T*w)))
+            if(hept_vertices.find(T*w) != -1)
               found_va = true;
           if(!found_va) continue;
           va.emplace_back(vertex_adjacency_info{allh[va[i].h_id]->move(d)->fieldval, T, va[i].move_sequence});
@@ -861,8 +865,9 @@ EX namespace reg3 {
     
     map<int, int> by_sides;
 
-    vector<map<unsigned, vector<hyperpoint> > > which_cell_0;
-    which_cell_0.resize(isize(allh));
+    /* cell centers, tagged by heptagon */
+    vertex_welder which_cell_0(1e-5);
+    vector<int> found_ids;
     
     acells_by_master.resize(isize(allh));
     for(int a=0; a<isize(allh); a++) {
@@ -871,8 +876,9 @@ EX namespace reg3 {
         auto& cc = ss[id].cellcenter;
         for(auto& va: vertex_adjacencies[a]) {
           hyperpoint h = iso_inverse(va.T) * cc;
-          for(auto h1: which_cell_0[va.h_id][bucketer(h)])
-            if(hdist(h1, h) < 1e-6)
+          which_cell_0.find_all(h, va.h_id, found_ids);
+          for(int id1: found_ids)
+            if(hdist(which_cell_0.points[id1], h) < 1e-6)
               exists = true;
           }
         if(exists) continue;
@@ -883,7 +889,7 @@ EX namespace reg3 {
         local_id[c] = {isize(acells), id};
         acells.push_back(c);
         acells_by_master[a].push_back(c);
-        which_cell_0[a][bucketer(cc)].push_back(cc);
+        which_cell_0.add(cc, a);
         }
       }
     
@@ -893,14 +899,26 @@ EX namespace reg3 {
     move_sequences.resize(isize(acells));
     int failures = 0;
     
-    vector<map<unsigned, vector<pair<cell*, int> > > > which_cell;
-    which_cell.resize(isize(allh));
+    /* face centers, tagged by heptagon; which_cell_at[k] is the face at the k-th point */
+    vertex_welder which_cell(1e-5);
+    vector<pair<cell*, int>> which_cell_at;
 
     for(cell *c: acells) {
       int id = local_id[c].second;
-      for(int i=0; i<c->type; i++)
-        which_cell[c->master->fieldval][bucketer(ss[id].face_centers[i])].emplace_back(c, i);
+      for(int i=0; i<c->type; i++) {
+        which_cell.add(ss[id].face_centers[i], c->master->fieldval);
+        which_cell_at.emplace_back(c, i);
+        }
       }
+
+    /* vertices of each subshape, tagged by subshape id; face_vertex_ids[id][i] lists the vertices of its i-th face */
+    vertex_welder subshape_vertices(1e-5);
+    vector<vector<vector<int>>> face_vertex_ids(isize(ss));
+    for(int id=0; id<isize(ss); id++)
+      for(auto& f: ss[id].faces) {
+        face_vertex_ids[id].emplace_back();
+        for(auto& v: f) face_vertex_ids[id].back().push_back(subshape_vertices.weld(v, id));
+        }
     
     strafe_data.resize(isize(acells));
     
@@ -934,8 +952,9 @@ EX namespace reg3 {
         
         for(auto& va: vertex_adjacencies[h_id]) {
           hyperpoint ctr1 = iso_inverse(va.T) * ctr;
-          auto bucket = bucketer(ctr1);
-          for(auto p: which_cell[va.h_id][bucket]) {
+          which_cell.find_all(ctr1, va.h_id, found_ids);
+          for(int k: found_ids) {
+            auto p = which_cell_at[k];
             cell *c1 = p.first;
             int j = p.second;
             int id1 = local_id[c1].second;
@@ -954,15 +973,20 @@ EX namespace reg3 {
                 auto& sd = strafe_data[cid][i];                
                 sd.resize(c->type, -1);
                 
+                /* the vertices of c1, as vertices of c (or -1) */
+                vector<vector<int>> c1_vertices(c1->type);
+                for(int j1=0; j1<c1->type; j1++) if(j1 != j)
+                  for(auto v: ss[id1].faces[j1])
+                    c1_vertices[j1].push_back(subshape_vertices.find(T2*v, id));
+
                 for(int i1=0; i1<c->type; i1++) {
-                  set<unsigned> facevertices;
-                  for(auto v: ss[id].faces[i1]) facevertices.insert(bucketer(v));
+                  auto& facevertices = face_vertex_ids[id][i1];
                   if(ss[id].dirdist[i][i1] == 1) {
                     int found_strafe = 0;
                     for(int j1=0; j1<c1->type; j1++) if(j1 != j) {
                       int num = 0;
-                      for(auto v: ss[id1].faces[j1])
-                        if(facevertices.count(bucketer(T2*v)))
+                      for(int v: c1_vertices[j1])
+                        if(v != -1 && std::find(facevertices.begin(), facevertices.end(), v) != facevertices.end())
                           num++;
                       if(num == 2) sd[i1] = j1, found_strafe++;
                       }
@@ -1433,14 +1457,68 @@ EX namespace reg3 {
       }
     };
 
+  /** \brief heptagons located relative to their binary tiling anchors, indexed by (anchor, quantized position)
+   *
+   *  Used to find whether a heptagon already exists at the given position. Positions which match
+   *  differ only by numerical errors, so neighbor buckets need to be probed only near the bucket boundaries.
+   */
+  struct altmap_index {
+    static constexpr ld step = 0.25;
+    static constexpr ld margin = 0.05;
+
+    struct key {
+      heptagon *alt;
+      int x, y, z;
+      bool operator == (const key& k) const { return alt == k.alt && x == k.x && y == k.y && z == k.z; }
+      };
+
+    struct key_hash {
+      size_t operator() (const key& k) const {
+        size_t res = std::hash<heptagon*>()(k.alt);
+        for(int v: {k.x, k.y, k.z}) res ^= size_t(v) + 0x9e3779b9 + (res << 6) + (res >> 2);
+        return res;
+        }
+      };
+
+    std::unordered_map<key, vector<pair<heptagon*, transmatrix>>, key_hash> grid;
+
+    key get_key(heptagon *alt, const hyperpoint& h) {
+      return key{alt, int(floor(h[0] / step)), int(floor(h[1] / step)), int(floor(h[2] / step))};
+      }
+
+    void add(heptagon *alt, heptagon *h, const transmatrix& T) {
+      grid[get_key(alt, tC0(T))].emplace_back(h, T);
+      }
+
+    /** the first entry at alt with intval(tC0(T), hT) < 1e-3, or nullptr; err is set to that intval */
+    pair<heptagon*, transmatrix>* find(heptagon *alt, hyperpoint hT, ld& err) {
+      key k = get_key(alt, hT);
+      int lo[3], hi[3];
+      int* kc[3] = {&k.x, &k.y, &k.z};
+      for(int i=0; i<3; i++) {
+        ld frac = hT[i] / step - *kc[i];
+        lo[i] = frac < margin / step ? -1 : 0;
+        hi[i] = frac > 1 - margin / step ? 1 : 0;
+        }
+      for(int dx=lo[0]; dx<=hi[0]; dx++)
+      for(int dy=lo[1]; dy<=hi[1]; dy++)
+      for(int dz=lo[2]; dz<=hi[2]; dz++) {
+        auto it = grid.find(key{alt, k.x+dx, k.y+dy, k.z+dz});
+        if(it == grid.end()) continue;
+        for(auto& p: it->second) if((err = intval(tC0(p.second), hT)) < 1e-3) return &p;
+        }
+      return nullptr;
+      }
+    };
+
   struct hrmap_h3 : hrmap_h3_abstract {
   
     heptagon *origin;
     hrmap *binary_map;
     vector<heptagon*> extra_origins;
     
-    map<heptagon*, pair<heptagon*, transmatrix>> reg_gmatrix;
-    map<heptagon*, vector<pair<heptagon*, transmatrix> > > altmap;
+    std::unordered_map<heptagon*, pair<heptagon*, transmatrix>> reg_gmatrix;
+    altmap_index altmap;
 
     vector<cell*>& allcells() override { 
       return hrmap::allcells();
@@ -1477,7 +1555,7 @@ EX namespace reg3 {
       #endif
       
       reg_gmatrix[origin] = make_pair(alt, T);
-      altmap[alt].emplace_back(origin, T);
+      altmap.add(alt, origin, T);
 
       if(PURE) {
         celllister cl(origin->c7, 4, 100000, NULL);
@@ -1538,7 +1616,7 @@ EX namespace reg3 {
 
     void verify_neighbors(heptagon *alt, int steps, const hyperpoint& hT) {
       ld err;
-      for(auto& p2: altmap[alt]) if((err = intval(tC0(p2.second), hT)) < 1e-3) {
+      if(altmap.find(alt, hT, err)) {
         println(hlog, "FAIL");
         exit(3);
         }
@@ -1574,11 +1652,10 @@ EX namespace reg3 {
       
       if(DEB) println(hlog, "searching at ", alt, ":", hT);
 
-      if(DEB) for(auto& p2: altmap[alt]) println(hlog, "for ", tC0(p2.second), " intval is ", intval(tC0(p2.second), hT));
-      
       ld err;
       
-      for(auto& p2: altmap[alt]) if((err = intval(tC0(p2.second), hT)) < 1e-3) {
+      if(auto found = altmap.find(alt, hT, err)) {
+        auto& p2 = *found;
         if(err > worst_error1) println(hlog, format("worst_error1 = %lg", double(worst_error1 = err)));
         // println(hlog, "YES found in ", isize(altmap[alt]));
         if(DEB) println(hlog, "-> found ", p2.first);
@@ -1639,7 +1716,7 @@ EX namespace reg3 {
       created->fiftyval = 9999;
       fixmatrix(T);
       reg_gmatrix[created] = make_pair(alt, T);
-      altmap[alt].emplace_back(created, T);
+      altmap.add(alt, created, T);
       created->c.connect(d2, parent, d, false);
       return created;
       }
@@ -1734,7 +1811,7 @@ EX namespace reg3 {
       created->s = hsOrigin;
       created->fieldval = quotient_map->acells[fv]->master->fieldval;
       reg_gmatrix[created] = make_pair(alt, T);
-      altmap[alt].emplace_back(created, T);
+      altmap.add(alt, created, T);
 
       extra_origins.push_back(created);
       return get_cell_at(created, fv);
@@ -146,12 +146,22 @@ namespace sag {
       }
     else if(gdist_prec && dijkstra_maxedge) {
       vector<vector<pair<int, ld>>> dijkstra_edges(N);
-      for(int i=0; i<N; i++) {
-        celllister cl(sagcells[i], dijkstra_maxedge, 50000, nullptr);
-        for(auto c1: cl.lst) if(ids.count(c1)) if(c1 != sagcells[i])
-          dijkstra_edges[i].emplace_back(ids[c1], pdist(tC0(cell_matrix[i]), tC0(cell_matrix[ids[c1]])));
-        if(i == 0) println(hlog, i, " has ", isize(dijkstra_edges[i]), " edges");
+      auto find_edges = [&] (int i, bool create) {
+        cellbfs cl(sagcells[i], dijkstra_maxedge, 50000, nullptr, create);
+        for(auto c1: cl.lst) if(c1 != sagcells[i]) {
+          auto it = ids.find(c1);
+          if(it != ids.end())
+            dijkstra_edges[i].emplace_back(it->second, pdist(tC0(cell_matrix[i]), tC0(cell_matrix[it->second])));
+          }
+        };
+      /* cellbfs is re-entrant, so the neighborhoods can be listed in parallel when no cells need to be created;
+         the links in closed maps may be created lazily, so create them all first */
+      if(closed_or_bounded) {
+        for(cell *c: currentmap->allcells()) for(int d=0; d<c->type; d++) c->cmove(d);
+        parallelize(N, [&] (int a, int b) { for(int i=a; i<b; i++) find_edges(i, false); return 0; });
         }
+      else for(int i=0; i<N; i++) find_edges(i, true);
+      if(N) println(hlog, 0, " has ", isize(dijkstra_edges[0]), " edges");
       parallelize(N, [&] (int a, int b) {
       vector<ld> distances(N);
       for(int i=a; i<b; i++) {
@@ -1098,8 +1108,11 @@ namespace sag {
     prepare_graph();
     create_viz();
 
+    vector<cell*> vcells(DN);
+    for(int i=0; i<DN; i++) vcells[i] = sagcells[sagid[i]];
+    auto cols = patterns::compute_cell_color_each(vcells);
     for(int i=0; i<DN; i++) {
-      color_t col = patterns::compute_cell_color(sagcells[sagid[i]]);
+      color_t col = cols[i];
       col <<= 8;
       col |= 0xFF;
       vdata[i].cp.color1 = vdata[i].cp.color2 = col;
@@ -160,20 +160,26 @@ bool draw_snow(cell *c, const shiftmatrix& V) {
     }
   
   poly_outline = 0xFF;
+  /* all the snowballs in this cell using the same shape go into a single draw queue item */
+  map<const hpcshape*, dqi_poly_instanced*> batches;
+  auto queue_instance = [&] (const shiftmatrix& V1, const hpcshape& sh, color_t col) -> dqi_poly_instanced& {
+    auto& b = batches[&sh];
+    if(!b) b = &queuepoly_instanced(sh);
+    b->add(V1, col);
+    return *b;
+    };
   for(auto& T: snowballs_at[c]) {
     if(models.size()) {
-     if(T.object_id == -1)
-        models[T.model_id].render(V*T.T);
-      else {
-        auto& m = models[T.model_id].get();
-        for(int i=m.objindex[T.object_id]; i<m.objindex[T.object_id+1]; i++) {
-          auto& obj = m.objs[i];
-          if(obj->color) queuepoly(V*T.T, obj->sh, obj->color);
-          }
+      auto& m = models[T.model_id].get();
+      int from = 0, to = isize(m.objs);
+      if(T.object_id != -1) from = m.objindex[T.object_id], to = m.objindex[T.object_id+1];
+      for(int i=from; i<to; i++) {
+        auto& obj = m.objs[i];
+        if(obj->color) queue_instance(V*T.T, obj->sh, obj->color);
         }
       }
     else {
-      auto& p = queuepoly(V * T.T, shapeid(snow_shape), T.color);
+      auto& p = queue_instance(V * T.T, shapeid(snow_shape), T.color);
       if(!snow_texture) p.tinf = nullptr;
       if(snow_intense) p.flags |= POLY_INTENSE;
       }
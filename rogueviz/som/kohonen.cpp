@@ -430,21 +430,21 @@ struct cellcrawler {
   
   vector<cellcrawlerdata> data;
   
-  void store(const cellwalker& o, int from, int spin, manual_celllister& cl) {
-    if(!cl.add(o.at)) return;
+  void store(const cellwalker& o, int from, int spin, int d, cellbfs& cl) {
+    if(!cl.add_at(o.at, d)) return;
     data.emplace_back(o, from, spin);
     }
   
   void build(const cellwalker& start) {
     data.clear();
-    manual_celllister cl;
-    store(start, 0, 0, cl);
+    cellbfs cl;
+    store(start, 0, 0, 0, cl);
     for(int i=0; i<isize(data); i++) {
       cellwalker cw0 = data[i].orig;
       for(int j=0; j<cw0.at->type; j++) {
         cellwalker cw = cw0 + j + wstep;
         if(!getNeuron(cw.at)) continue;
-        store(cw, i, j, cl);
+        store(cw, i, j, cl.dists[i]+1, cl);
         }
       }
     if(gaussian || true) for(cellcrawlerdata& s: data)
@@ -781,11 +781,11 @@ vector<cell*> gen_neuron_cells() {
   vector<cell*> allcells;
   
   if(krad) {
-    celllister cl(cwt.at, krad, 1000000, NULL);
+    cellbfs cl(cwt.at, krad, 1000000, NULL);
     allcells = cl.lst;
     }
   else if(kqty) {
-    celllister cl(cwt.at, 999, kqty, NULL);
+    cellbfs cl(cwt.at, 999, kqty, NULL);
     allcells = cl.lst;
     allcells.resize(kqty);
     }
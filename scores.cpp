@@ -8,7 +8,9 @@
 #include "hyper.h"
 #if CAP_SAVE
 
-namespace hr { namespace scores {
+namespace hr {
+
+EX namespace scores {
 
 vector<score> scores;
 score *currentgame;
@@ -280,26 +282,30 @@ void show() {
     };
   }
 
-void load() {
-  if(scorefile == "") return;
-  scores.clear();
-  FILE *f = fopen(scorefile.c_str(), "rt");
-  if(!f) {
-    printf("Could not open the score file '%s'!\n", scorefile.c_str());
-    addMessage(s0 + "Could not open the score file: " + scorefile);
-    return;
-    }
+/** \brief parse the text scorefile from the current position to the end, adding the scores to be listed to res
+ *  @return the position after the last complete line; a record which has not been completely written yet
+ *  (e.g. by another process) is not added, and the returned position is before it
+ */
+long long parse_scores(FILE *f, vector<score>& res) {
+  long long safe = ftell(f);
   while(!feof(f)) {
     char buf[120];
     if(fgets(buf, 120, f) == NULL) break;
     if(buf[0] == 'H' && buf[1] == 'y') {
       score sc; bool ok = true;
       sc.box[MAXBOX-1] = 0;
-      {if(fscanf(f, "%s", buf) <= 0) break;} sc.ver = buf;
-    
 
+      /* the line with the version and the boxes; the record is used only if this line is complete */
+      string line;
+      int c;
+      while((c = fgetc(f)) != EOF && c != '\n') line += char(c);
+      if(c == EOF) break;
+      safe = ftell(f);
+
+      std::stringstream ss(line);
+      if(!(ss >> sc.ver)) continue;
       for(int i=0; i<MAXBOX; i++) {
-        if(fscanf(f, "%d", &sc.box[i]) <= 0) { boxid = i; break; }
+        if(!(ss >> sc.box[i])) { boxid = i; break; }
         }
       
       for(int i=boxid; i<MAXBOX; i++) sc.box[i] = 0;
@@ -318,11 +324,189 @@ void load() {
         sc.box[0] = sc.box[1] - sc.box[0]; // could not save then
       
       if(sc.box[2] == 0) continue; // do not list zero scores
-      sc.box[POSSCORE] = modediff(&sc);
       
-      if(ok && boxid > 20) scores.push_back(sc);
+      if(ok && boxid > 20) res.push_back(sc);
+      }
+    else if(strchr(buf, '\n')) safe = ftell(f);
+    }
+  return safe;
+  }
+
+/** \brief binary index of the scorefile
+ *
+ *  Parsing the whole text scorefile whenever the scores are viewed gets slow for long-running installations.
+ *  The parsed score records are appended to a binary file (scorefile + ".idx") in chunks. Every chunk remembers
+ *  how far the text scorefile has been parsed, and a hash of the text just before that point, so only the new
+ *  part of the scorefile needs to be parsed. If the scorefile has been truncated or replaced, the index is rebuilt.
+ *  The text scorefile remains the authoritative copy.
+ */
+
+EX bool use_score_index = true;
+
+/** \brief aggregate statistics for a single modecode */
+struct mode_summary {
+  int games;
+  int best;
+  };
+
+struct score_index {
+  /** the scorefile this index is for */
+  string fname;
+  /** parsed records, in the scorefile order */
+  vector<score> records;
+  /** how far the scorefile has been parsed */
+  long long text_pos;
+  /** hash of the text just before text_pos */
+  unsigned tail_hash;
+  /** record ids for every modecode */
+  map<int, vector<int>> by_modecode;
+  /** aggregates for every modecode, computed as the records are added */
+  map<int, mode_summary> summary;
+
+  void clear() {
+    records.clear(); by_modecode.clear(); summary.clear();
+    text_pos = 0; tail_hash = 0;
+    }
+
+  void add(const score& sc) {
+    int mc = sc.box[MODECODE_BOX];
+    by_modecode[mc].push_back(isize(records));
+    auto& su = summary[mc];
+    su.games++;
+    su.best = max(su.best, sc.box[2]);
+    records.push_back(sc);
+    }
+  };
+
+score_index score_idx;
+
+/** \brief the number of records in score_idx, and their boxes (the score_index struct is not exported) */
+EX int index_size() { return isize(score_idx.records); }
+EX int index_box(int id, int b) { return score_idx.records[id].box[b]; }
+
+/** \brief how far the scorefile has been indexed */
+EX long long index_text_pos() { return score_idx.text_pos; }
+
+static const int INDEX_MAGIC = 0x49535248;
+static const int CHUNK_MAGIC = 0x4B4E4843;
+
+/** \brief hash of (up to) 256 bytes of f before pos */
+unsigned text_hash(FILE *f, long long pos) {
+  char buf[256];
+  long long from = max<long long>(pos - 256, 0);
+  fseek(f, from, SEEK_SET);
+  int q = fread(buf, 1, pos - from, f);
+  unsigned h = 2166136261u;
+  for(int i=0; i<q; i++) h = (h ^ (unsigned char) buf[i]) * 16777619u;
+  return h ^ q;
+  }
+
+void write_record(hstream& hs, const score& sc) {
+  int n = MAXBOX;
+  while(n && !sc.box[n-1]) n--;
+  hs.write(sc.ver);
+  hs.write<int>(n);
+  for(int i=0; i<n; i++) hs.write<int>(sc.box[i]);
+  }
+
+void read_record(hstream& hs, score& sc) {
+  hs.read(sc.ver);
+  int n = hs.get<int>();
+  if(n < 0 || n > MAXBOX) throw hstream_exception();
+  for(int i=0; i<n; i++) sc.box[i] = hs.get<int>();
+  for(int i=n; i<MAXBOX; i++) sc.box[i] = 0;
+  }
+
+string index_file() { return scorefile + ".idx"; }
+
+/** \brief read the index file into score_idx; returns false if it is missing, or has a damaged or unfinished chunk at the end */
+bool read_index() {
+  score_idx.clear();
+  fhstream f(index_file(), "rb");
+  if(!f.f) return false;
+  fseek(f.f, 0, SEEK_END);
+  long long size = ftell(f.f);
+  fseek(f.f, 0, SEEK_SET);
+  try {
+    if(f.get<int>() != INDEX_MAGIC) return false;
+    while(ftell(f.f) < size) {
+      if(f.get<int>() != CHUNK_MAGIC) return false;
+      int n = f.get<int>();
+      vector<score> chunk(n);
+      for(auto& sc: chunk) read_record(f, sc);
+      long long pos = f.get<long long>();
+      unsigned hash = f.get<unsigned>();
+      if(f.get<int>() != CHUNK_MAGIC) return false;
+      for(auto& sc: chunk) score_idx.add(sc);
+      score_idx.text_pos = pos;
+      score_idx.tail_hash = hash;
       }
     }
+  catch(hstream_exception&) { return false; }
+  return true;
+  }
+
+/** \brief write the records from the given one on as a new chunk; if rewrite, the index file is recreated from scratch */
+void write_index(int from, bool rewrite) {
+  shstream ss;
+  if(rewrite) ss.write<int>(INDEX_MAGIC);
+  ss.write<int>(CHUNK_MAGIC);
+  ss.write<int>(isize(score_idx.records) - from);
+  for(int i=from; i<isize(score_idx.records); i++) write_record(ss, score_idx.records[i]);
+  ss.write<long long>(score_idx.text_pos);
+  ss.write<unsigned>(score_idx.tail_hash);
+  ss.write<int>(CHUNK_MAGIC);
+  FILE *f = fopen(index_file().c_str(), rewrite ? "wb" : "ab");
+  if(!f) return;
+  if(fwrite(ss.s.c_str(), isize(ss.s), 1, f) != 1)
+    println(hlog, "could not write the score index: ", index_file());
+  fclose(f);
+  }
+
+/** \brief bring score_idx up to date with the scorefile, parsing only what has been appended since the last time */
+EX bool update_index() {
+  FILE *f = fopen(scorefile.c_str(), "rt");
+  if(!f) return false;
+
+  bool rewrite = false;
+  if(!use_score_index) score_idx.clear(), score_idx.fname = "";
+  else if(score_idx.fname != scorefile) {
+    score_idx.fname = scorefile;
+    rewrite = !read_index();
+    }
+
+  fseek(f, 0, SEEK_END);
+  long long size = ftell(f);
+  if(score_idx.text_pos > size || text_hash(f, score_idx.text_pos) != score_idx.tail_hash) {
+    if(score_idx.text_pos) println(hlog, "the score file has changed, rebuilding the score index");
+    score_idx.clear();
+    rewrite = true;
+    }
+
+  int from = isize(score_idx.records);
+  fseek(f, score_idx.text_pos, SEEK_SET);
+  vector<score> added;
+  long long pos = parse_scores(f, added);
+  for(auto& sc: added) score_idx.add(sc);
+
+  if(use_score_index && (pos != score_idx.text_pos || rewrite)) {
+    score_idx.text_pos = pos;
+    score_idx.tail_hash = text_hash(f, pos);
+    write_index(rewrite ? 0 : from, rewrite);
+    }
+  fclose(f);
+  return true;
+  }
+
+void load() {
+  if(scorefile == "") return;
+  if(!update_index()) {
+    printf("Could not open the score file '%s'!\n", scorefile.c_str());
+    addMessage(s0 + "Could not open the score file: " + scorefile);
+    return;
+    }
+  scores = score_idx.records;
+  for(auto& sc: scores) sc.box[POSSCORE] = modediff(&sc);
 
   saveBox();
   score sc; 
@@ -331,7 +515,6 @@ void load() {
   sc.box[MAXBOX-1] = 1; sc.ver = "NOW";
   scores.push_back(sc);
   
-  fclose(f);
   clearMessages();
   // addMessage(its(isize(scores))+" games have been recorded in "+scorefile);
   pushScreen(show);
@@ -343,7 +526,29 @@ void load() {
     });
   }
 
-}}
+#if CAP_COMMANDLINE
+int read_score_args() {
+  using namespace arg;
+  if(0) ;
+  else if(argis("-score-index")) {
+    shift(); use_score_index = argi();
+    }
+  else if(argis("-score-summary")) {
+    PHASE(3);
+    if(!update_index()) { println(hlog, "could not open the score file: ", scorefile); return 0; }
+    println(hlog, isize(score_idx.records), " scores in ", scorefile);
+    for(auto& p: score_idx.summary)
+      println(hlog, "modecode ", p.first, ": ", p.second.games, " games, best ", p.second.best);
+    }
+  else return 1;
+  return 0;
+  }
+
+auto ah = addHook(hooks_args, 0, read_score_args);
+#endif
+
+EX }
+}
 
 #endif
 
@@ -1170,6 +1170,8 @@ struct animated_parameter {
   ld last;
   string formula;
   reaction_t reaction;
+  /** formula compiled in animate_parameter, evaluated every frame */
+  compiled_exp code;
   };
 #endif
 
@@ -1189,17 +1191,25 @@ EX void get_parameter_animation(ld &x, string &s) {
 
 EX void animate_parameter(ld &x, string f, const reaction_t& r) {
   deanimate(x);
-  aps.emplace_back(animated_parameter{&x, x, f, r});
+  compiled_exp code;
+  try { code = compile_exp(f, {}); }
+  catch(hr_parse_exception&) { }
+  aps.emplace_back(animated_parameter{&x, x, f, r, code});
   }
 
 int ap_changes;
 
+/** the frame for evaluating the compiled formulas, reused for all the parameters and all the frames */
+vector<cld> ap_frame;
+
 void apply_animated_parameters() {
   ap_changes = 0;
   for(auto &ap: aps) {
     if(*ap.value != ap.last) continue;
     try {
-      *ap.value = parseld(ap.formula);
+      if(isize(ap_frame) <= ap.code.frame_size) ap_frame.resize(ap.code.frame_size + 1);
+      if(ap.code) *ap.value = ap.code.eval_real(ap_frame.data());
+      else *ap.value = parseld(ap.formula);
       }
     catch(hr_parse_exception&) {
       continue;
@@ -57,6 +57,55 @@ EX void prepare_sky() {
     }
   }
 
+/** in ideal geometries, the sky over the triangle (C0, ci, cj) is subdivided; the local points depend only on the corners, so they are shared by all cells of the same shape */
+struct sky_template {
+  static const int prec = 8;
+  hyperpoint sky[prec+1][prec+1], hell[prec+1][prec+1];
+  };
+
+struct sky_corners {
+  hyperpoint ci, cj;
+  bool operator == (const sky_corners& k) const {
+    for(int i=0; i<MAXMDIM; i++) if(ci[i] != k.ci[i] || cj[i] != k.cj[i]) return false;
+    return true;
+    }
+  };
+
+struct sky_corners_hash {
+  size_t operator() (const sky_corners& k) const {
+    size_t h = 0;
+    for(int i=0; i<MAXMDIM; i++) h = (h * 1000003 ^ std::hash<ld>()(k.ci[i])) * 1000003 ^ std::hash<ld>()(k.cj[i]);
+    return h;
+    }
+  };
+
+std::unordered_map<sky_corners, sky_template, sky_corners_hash> sky_templates;
+geometry_information *sky_templates_cgi;
+ld sky_templates_level;
+
+const sky_template& get_sky_template(hyperpoint ci, hyperpoint cj) {
+  if(sky_templates_cgi != cgip || sky_templates_level != cgi.SKY) {
+    sky_templates.clear();
+    sky_templates_cgi = cgip; sky_templates_level = cgi.SKY;
+    }
+  sky_corners key = {ci, cj};
+  auto it = sky_templates.find(key);
+  if(it != sky_templates.end()) return it->second;
+  auto& t = sky_templates[key];
+  const int prec = sky_template::prec;
+  hyperpoint skypoint = cpush0(2, cgi.SKY);
+  hyperpoint hellpoint = cpush0(2, -cgi.SKY);
+  ci = (ci - C0)/prec;
+  cj = (cj - C0)/prec;
+  for(int x=0; x<=prec; x++)
+  for(int y=0; y<=prec-x; y++) {
+    transmatrix h = rgpushxto0(normalize(C0+ci*min<ld>(x, prec - .01)+cj*min<ld>(y, prec-.01)));
+    t.sky[y][x] = h * skypoint;
+    t.hell[y][x] = h * hellpoint;
+    }
+  return t;
+  }
+
 EX vector<glhr::colored_vertex> skyvertices;
 EX cell *sky_centerover;
 EX shiftmatrix sky_cview;
@@ -64,6 +113,7 @@ EX shiftmatrix sky_cview;
 EX void delete_sky() {
   sky_centerover = nullptr;
   skyvertices.clear();
+  sky_templates.clear();
   }
 
 void compute_skyvertices(const vector<sky_item>& sky) {
@@ -79,11 +129,19 @@ void compute_skyvertices(const vector<sky_item>& sky) {
 
   int sk = get_skybrightness();
   
-  std::map<cell*, pair<color_t, color_t>> colors;
-  for(const sky_item& si: sky) colors[si.c] = 
-    make_pair(darkena(gradient(0, si.color, 0, sk, 255), 0, 0xFF),
-        darkena(si.skycolor, 0, 0xFF)
-        );
+  /* colors of the sky items, and the index of the item of every cell */
+  vector<pair<color_t, color_t>> colors(isize(sky));
+  std::unordered_map<cell*, int> sky_id;
+  sky_id.reserve(isize(sky));
+  for(int i=0; i<isize(sky); i++) {
+    auto& si = sky[i];
+    colors[i] = make_pair(darkena(gradient(0, si.color, 0, sk, 255), 0, 0xFF), darkena(si.skycolor, 0, 0xFF));
+    sky_id[si.c] = i;
+    }
+  auto color_of = [&] (cell *c) -> pair<color_t, color_t>* {
+    auto it = sky_id.find(c);
+    return it == sky_id.end() ? nullptr : &colors[it->second];
+    };
   
   hyperpoint skypoint = cpush0(2, cgi.SKY);
   hyperpoint hellpoint = cpush0(2, -cgi.SKY);
@@ -104,18 +162,16 @@ void compute_skyvertices(const vector<sky_item>& sky) {
         transmatrix T1 = unshift(si.T);
         hyperpoint ci = kleinize(get_corner_position(c, i, 3));
         hyperpoint cj = kleinize(get_corner_position(c, j, 3));
-        static const int prec = 8;
-        ci = (ci - C0)/prec;
-        cj = (cj - C0)/prec;
+        const int prec = sky_template::prec;
+        auto& t = get_sky_template(ci, cj);
         glhr::colored_vertex vs[prec+1][prec+1], vh[prec+1][prec+1];
         
-        auto& co = colors[c];
+        auto& co = *color_of(c);
         
         for(int x=0; x<=prec; x++)
         for(int y=0; y<=prec-x; y++) {
-          transmatrix h = T1 * rgpushxto0(normalize(C0+ci*min<ld>(x, prec - .01)+cj*min<ld>(y, prec-.01)));
-          vs[y][x] = glhr::colored_vertex(h * skypoint, co.first);
-          vh[y][x] = glhr::colored_vertex(h * hellpoint, co.second);
+          vs[y][x] = glhr::colored_vertex(T1 * t.sky[y][x], co.first);
+          vh[y][x] = glhr::colored_vertex(T1 * t.hell[y][x], co.second);
           }
                 
         for(int x=0; x<prec; x++)
@@ -142,7 +198,7 @@ void compute_skyvertices(const vector<sky_item>& sky) {
             }
           }
         
-        if(!colors.count(c->move(i))) {
+        if(!color_of(c->move(i))) {
           for(int i=0; i<prec; i++) {
             int j = i+1;
             skyvertices.emplace_back(vs[i][prec-i]);
@@ -165,18 +221,18 @@ void compute_skyvertices(const vector<sky_item>& sky) {
         cellwalker cw0(c, i);
         cellwalker cw2 = cw0;
         cw2--; cw2 += wstep;
-        if(!colors.count(cw2.at)) {
+        if(!color_of(cw2.at)) {
           this_poly.clear();
           transmatrix T1 = Id;
           transmatrix T2 = unshift(si.T);
           auto cw = cw0;
-          auto co = at_or_null(colors, cw.at);
+          auto co = color_of(cw.at);
           while(co) {
             this_poly.emplace_back(T2 * T1 * skypoint, co->first);
             this_poly.emplace_back(T2 * T1 * hellpoint, co->second);
             auto cw1 = cw;
             cw += wstep; cw++;
-            auto co1 = at_or_null(colors, cw.at);
+            auto co1 = color_of(cw.at);
             if(!co1) break;
             transmatrix A = currentmap->adj(cw1.at, cw1.spin);
             hyperpoint a = tC0(A);
@@ -208,7 +264,7 @@ void compute_skyvertices(const vector<sky_item>& sky) {
         cellwalker cw = cw0;
         do {
           cw += wstep; cw++;
-          if(cw.at < c || !colors.count(cw.at)) goto next;
+          if(cw.at < c || !color_of(cw.at)) goto next;
           }
         while(cw != cw0);
           
@@ -218,7 +274,7 @@ void compute_skyvertices(const vector<sky_item>& sky) {
         transmatrix T1 = Id;
         do {
           vertices.push_back(T1 * tctr);
-          vcolors.push_back(colors[cw.at].first);
+          vcolors.push_back(color_of(cw.at)->first);
           T1 = T1 * currentmap->adj(cw.at, cw.spin);
           cw += wstep; cw++;
           }
@@ -305,6 +361,15 @@ color_t skycolor(cell *c) {
   return gradient(0x4040FF, 0xFFFFFF, 0, z, 63);
   }
 
+/** compute the sky mesh for all the cells within distance d of centerover, without drawing them; returns the number of vertices */
+EX int compute_sky_for(int d) {
+  vector<sky_item> items;
+  celllister cl(centerover, d, 1000000, nullptr);
+  for(cell *c: cl.lst) items.emplace_back(c, shiftless(calc_relative_matrix(c, centerover, C0)), skycolor(c), skycolor(c));
+  compute_skyvertices(items);
+  return isize(skyvertices);
+  }
+
 /** move an Euclidean matrix to V(C0) == C0 */
 EX void be_euclidean_infinity(transmatrix& V) { for(int i=0; i<3; i++) V[i][3] = 0; }
 
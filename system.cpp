@@ -941,7 +941,7 @@ void loadBox() {
   boxid = 0; loading = true; applyBoxes(); loading = false;
   }
 
-const int MODECODE_BOX = 387;
+EX const int MODECODE_BOX = 387;
 
 modecode_t fill_modecode() {
   dynamicval<int> sp1(multi::players, save.box[197]);
@@ -1756,7 +1756,7 @@ EX void finishAll() {
 
 auto cgm = addHook(hooks_clearmemory, 40, [] () {
   pathq.clear();
-  dcal.clear();
+  clear_dcal();
   clearshadow();
   for(int i=0; i<MAXPLAYER; i++) lastmountpos[i] = NULL;
   seenSevenMines = false;
@@ -498,7 +498,7 @@ bool texture_config::apply(cell *c, const shiftmatrix &V, color_t col) {
   if(config.tstate == tsOff || !correctly_mapped) return false;
 
   using namespace patterns;
-  auto si = getpatterninfo0(c);
+  auto si = indexed_patterninfo(c);
 
   if(config.tstate == tsAdjusting) {
     dynamicval<color_t> d(poly_outline, slave_color);
@@ -587,7 +587,7 @@ void texture_config::perform_mapping() {
 
   for(auto& p: gmatrix) {
     cell *c = p.first;
-    auto si = getpatterninfo0(c);
+    auto si = indexed_patterninfo(c);
     bool replace = false;
     
     // int sgn = sphere ? -1 : 1;
@@ -613,7 +613,7 @@ void texture_config::perform_mapping() {
       if(models.count(c2)) 
         nearmodel = true;
     if(nearmodel) {
-      auto si = getpatterninfo0(c);
+      auto si = indexed_patterninfo(c);
       texture_map[si.id].matrices.push_back(p.second * applyPatterndir(c, si));
       }
     }
@@ -74,6 +74,45 @@ EX ld ilerp(ld a0, ld a1, ld x) {
 
 EX purehookset hooks_tests;
 
+/** the number of threads worth using for parallel computations */
+EX int available_threads() {
+  #if CAP_THREAD
+  return max<int>(std::thread::hardware_concurrency(), 1);
+  #else
+  return 1;
+  #endif
+  }
+
+#if CAP_THREAD
+std::thread::id main_thread_id = std::this_thread::get_id();
+#endif
+
+/** is this the main thread? (functions which create cells or use global caches check this) */
+EX bool in_main_thread() {
+  #if CAP_THREAD
+  return std::this_thread::get_id() == main_thread_id;
+  #else
+  return true;
+  #endif
+  }
+
+#if HDR
+/** \brief split [0, N) into (at most) threads ranges, and call action(from, to, thread_id) for each of them, in parallel if possible */
+template<class T> void parallel_ranges(int N, int threads, const T& action) {
+  #if CAP_THREAD
+  threads = min(threads, N);
+  if(threads > 1) {
+    std::vector<std::thread> v;
+    for(int k=0; k<threads; k++)
+      v.emplace_back([&action, k, N, threads] { action(N*(long long)k/threads, N*(long long)(k+1)/threads, k); });
+    for(std::thread& t: v) t.join();
+    return;
+    }
+  #endif
+  action(0, N, 0);
+  }
+#endif
+
 EX string simplify(const string& s) {
   string res;
   for(char c: s) if(isalnum(c)) res += c;
@@ -91,11 +130,38 @@ struct hr_parse_exception : hr_exception {
   ~hr_parse_exception() noexcept(true) {}
   };
 
+/** code produced by exp_parser::compile: computes the value, given the frame of slot values */
+typedef std::function<cld(cld*)> exp_code;
+
+/** a node of a formula during compilation; constant subexpressions are folded */
+struct exp_node {
+  exp_code f;
+  bool is_const;
+  cld val;
+  };
+
+/** the argument values passed to a function in a formula (see exp_parser::call) */
+struct exp_args {
+  const cld *p;
+  int n;
+  const cld& operator [] (int i) const { return p[i]; }
+  int size() const { return n; }
+  const cld& back() const { return p[n-1]; }
+  };
+
+typedef std::function<cld(const exp_args&)> exp_function;
+
 struct exp_parser {
   string s;
   int at;
   int line_number, last_line;
-  exp_parser() { at = 0; line_number = 1; last_line = 0; }
+  /** names of the variables (taken from the frame) during compilation; let(...) pushes its temporaries here */
+  vector<string> slots;
+  /** used[i] is true iff the compiled formula refers to the i-th slot */
+  vector<bool> used;
+  /** number of frame slots needed, including the temporaries */
+  int frame_size;
+  exp_parser() { at = 0; line_number = 1; last_line = 0; frame_size = 0; }
   
   string where() { 
     if(s.find('\n')) return "(line " + its(line_number) + ", pos " + its(at-last_line) + ")";
@@ -127,8 +193,16 @@ struct exp_parser {
 
   vector<pair<ld, ld>> parse_with_reps();
 
+  /** parse and evaluate, with extra_params as the variables */
   cld parse(int prio = 0);
 
+  int find_slot(const string& name);
+  exp_node compile_par();
+  vector<exp_node> compile_args(int n);
+  exp_node call(const vector<exp_node>& args, const exp_function& fn, bool pure = true);
+  /** compile the expression, with the names in slots as variables */
+  exp_node compile(int prio = 0);
+
   ld rparse(int prio = 0) { return validate_real(parse(prio)); }
   int iparse(int prio = 0) { return int(floor(rparse(prio) + .5)); }
 
@@ -151,6 +225,54 @@ struct exp_parser {
   };
 #endif
 
+#if CAP_ANIMATIONS
+static const cld NO_DERIVATIVE(3.1, 2.5);
+
+/** evaluate the spline given by the '..' syntax, at the current time */
+static cld spline_value(vector<array<cld, 4>>& rest) {
+  ld v = ticks * (isize(rest)-1.) / anims::period;
+  int vf = v;
+  v -= vf;
+  if(isize(rest) == 1) rest.push_back(rest[0]);
+  vf %= (isize(rest)-1);
+  auto& lft = rest[vf];
+  auto& rgt = rest[vf+1];
+  if(lft[3] == NO_DERIVATIVE && rgt[1] == NO_DERIVATIVE)
+    return lerp(lft[2], rgt[0], v);
+  else if(rgt[1] == NO_DERIVATIVE)
+    return lerp(lft[2] + lft[3] * v, rgt[0], v*v);
+  else if(lft[3] == NO_DERIVATIVE)
+    return lerp(lft[2], rgt[0] + rgt[1] * (v-1), (2-v)*v);
+  else
+    return lerp(lft[2] + lft[3] * v, rgt[0] + rgt[1] * (v-1), v*v*(3-2*v));
+  }
+#endif
+
+static ld regangle_value(ld edgelen, ld edges) {
+  ld alpha = M_PI / edges;
+  if(isinf(edges)) {
+    ld u = sqrt(cosh(edgelen) * 2 - 2);
+    ld a = atan2(1, u/2);
+    return 2 * a;
+    }
+  ld c = asin_auto(sin_auto(edgelen/2) / sin(alpha));
+  hyperpoint h = xpush(c) * spin(M_PI - 2*alpha) * xpush0(c);
+  ld result = 2 * atan2(h);
+  if(result < 0) result = -result;
+  cyclefix(result, 0);
+  return result;
+  }
+
+#if CAP_ARCM
+static ld arcmcurv_value(const vector<pair<ld, ld>>& vals) {
+  ld total = 0;
+  for(auto p: vals) total += p.second * (180 - 360 / p.first);
+  total = (360 - total) * degree;
+  if(abs(total) < 1e-10) total = 0;
+  return total;
+  }
+#endif
+
 void exp_parser::skip_white() {
   while(next() == ' ' || next() == '\n' || next() == '\r' || next() == '\t') {
     if(next() == '\r') last_line++;
@@ -188,288 +310,387 @@ vector<pair<ld, ld>> exp_parser::parse_with_reps() {
   return vals;
   }
 
-cld exp_parser::parse(int prio) {
-  cld res;
-  skip_white();
-  if(eat("sin(")) res = sin(parsepar());
-  else if(eat("cos(")) res = cos(parsepar());
-  else if(eat("sinh(")) res = sinh(parsepar());
-  else if(eat("cosh(")) res = cosh(parsepar());
-  else if(eat("asin(")) res = asin(parsepar());
-  else if(eat("acos(")) res = acos(parsepar());
-  else if(eat("asinh(")) res = asinh(parsepar());
-  else if(eat("acosh(")) res = acosh(parsepar());
-  else if(eat("exp(")) res = exp(parsepar());
-  else if(eat("sqrt(")) res = sqrt(parsepar());
-  else if(eat("log(")) res = log(parsepar());
-  else if(eat("tan(")) res = tan(parsepar());
-  else if(eat("tanh(")) res = tanh(parsepar());
-  else if(eat("atan(")) res = atan(parsepar());
-  else if(eat("atanh(")) res = atanh(parsepar());
-  else if(eat("abs(")) res = abs(parsepar());
-  else if(eat("re(")) res = real(parsepar());
-  else if(eat("im(")) res = imag(parsepar());
-  else if(eat("conj(")) res = std::conj(parsepar());
-  else if(eat("floor(")) res = floor(validate_real(parsepar()));
-  else if(eat("frac(")) { res = parsepar(); res = res - floor(validate_real(res)); }
-  else if(eat("to01(")) { res = parsepar(); return atan(res) / ld(M_PI) + ld(0.5); }
-  else if(eat("min(")) {
-    ld a = rparse(0);
-    while(skip_white(), eat(",")) a = min(a, rparse(0));
-    force_eat(")");
-    res = a;
-    }
-  else if(eat("max(")) {
-    ld a = rparse(0);
-    while(skip_white(), eat(",")) a = max(a, rparse(0));
-    force_eat(")");
-    res = a;
+EX ld parseld(const string& s) {
+  exp_parser ep;
+  ep.s = s;
+  return ep.rparse();
+  }
+
+EX int parseint(const string& s) {
+  exp_parser ep;
+  ep.s = s;
+  return ep.iparse();
+  }
+
+#if HDR
+/** \brief a formula compiled once with compile_exp, to be evaluated many times
+ *  Variables are resolved to slots in the frame, so no string lookups happen during evaluation.
+ */
+struct compiled_exp {
+  exp_code code;
+  /** number of slots in the frame, including the temporaries used by let(...) */
+  int frame_size;
+  /** used[i] is true iff the formula refers to the i-th slot name */
+  vector<bool> used;
+  compiled_exp() : frame_size(0) {}
+  explicit operator bool() const { return bool(code); }
+  cld operator () (cld *frame) const { return code(frame); }
+  ld eval_real(cld *frame) const;
+  };
+
+#endif
+
+static exp_node exp_const(cld v) {
+  exp_node n;
+  n.is_const = true; n.val = v;
+  n.f = [v] (cld*) { return v; };
+  return n;
+  }
+
+static exp_node exp_dynamic(const exp_code& f) {
+  exp_node n;
+  n.is_const = false; n.val = 0;
+  n.f = f;
+  return n;
+  }
+
+static exp_node exp_apply(const exp_node& a, const std::function<cld(cld)>& fn) {
+  if(a.is_const) return exp_const(fn(a.val));
+  auto af = a.f;
+  return exp_dynamic([af, fn] (cld *v) { return fn(af(v)); });
+  }
+
+static exp_node exp_apply2(const exp_node& a, const exp_node& b, const std::function<cld(cld, cld)>& fn) {
+  if(a.is_const && b.is_const) return exp_const(fn(a.val, b.val));
+  auto af = a.f, bf = b.f;
+  return exp_dynamic([af, bf, fn] (cld *v) { return fn(af(v), bf(v)); });
+  }
+
+
+static ld exp_real(cld x, const string& where) {
+  if(kz(imag(x))) throw hr_parse_exception("expected real number but " + lalign(-1, x) + " found at " + where);
+  return real(x);
+  }
+
+ld compiled_exp::eval_real(cld *frame) const {
+  return exp_real(code(frame), "the result");
+  }
+
+int exp_parser::find_slot(const string& name) {
+  for(int i=isize(slots)-1; i>=0; i--) if(slots[i] == name) {
+    if(i < isize(used)) used[i] = true;
+    return i;
     }
-  else if(eat("edge(")) {
-    ld a = rparse(0);
-    force_eat(",");
-    ld b = rparse(0);
-    force_eat(")");
-    res = edge_of_triangle_with_angles(TAU/a, M_PI/b, M_PI/b);
+  return -1;
+  }
+
+exp_node exp_parser::compile_par() {
+  exp_node res = compile();
+  force_eat(")");
+  return res;
+  }
+
+/** apply fn to the values of all args; it is folded only if all args are constant and pure (the result depends on nothing else, e.g., not on the current geometry)
+ *  The values are computed into frame slots reserved here. They are above the slots used by args, so nested calls and lets do not overwrite them.
+ */
+exp_node exp_parser::call(const vector<exp_node>& args, const exp_function& fn, bool pure) {
+  bool all_const = pure;
+  for(auto& a: args) if(!a.is_const) all_const = false;
+  if(all_const) {
+    vector<cld> vals;
+    for(auto& a: args) vals.push_back(a.val);
+    return exp_const(fn(exp_args{vals.data(), isize(vals)}));
     }
-  else if(eat("edge_angles(")) {
-    cld a = rparse(0);
-    force_eat(",");
-    cld b = rparse(0);
-    force_eat(",");
-    cld c = rparse(0);
-    force_eat(")");
+  vector<exp_code> codes;
+  for(auto& a: args) codes.push_back(a.f);
+  int base = frame_size;
+  frame_size += isize(codes);
+  return exp_dynamic([codes, fn, base] (cld *v) {
+    for(int i=0; i<isize(codes); i++) v[base+i] = codes[i](v);
+    return fn(exp_args{v+base, isize(codes)});
+    });
+  }
 
-    if (auto *angleunit = hr::at_or_null(extra_params, "angleunit")) {
-      a *= *angleunit;
-      b *= *angleunit;
-      c *= *angleunit;
-      }
+/** compile n comma-separated arguments and the closing parenthesis */
+vector<exp_node> exp_parser::compile_args(int n) {
+  vector<exp_node> res;
+  for(int i=0; i<n; i++) {
+    if(i) force_eat(",");
+    res.push_back(compile(0));
+    }
+  force_eat(")");
+  return res;
+  }
 
-    return edge_of_triangle_with_angles(real(a), real(b), real(c));
+exp_node exp_parser::compile(int prio) {
+  exp_node res;
+  skip_white();
+  /* errors found during evaluation refer to this position */
+  string w = where();
+  typedef cld (*cfun)(const cld&);
+  static const vector<pair<const char*, cfun>> unary = {
+    {"sin(", std::sin}, {"cos(", std::cos}, {"sinh(", std::sinh}, {"cosh(", std::cosh},
+    {"asin(", std::asin}, {"acos(", std::acos}, {"asinh(", std::asinh}, {"acosh(", std::acosh},
+    {"exp(", std::exp}, {"sqrt(", std::sqrt}, {"log(", std::log}, {"tan(", std::tan},
+    {"tanh(", std::tanh}, {"atan(", std::atan}, {"atanh(", std::atanh}, {"conj(", std::conj}
+    };
+  bool found = false;
+  for(auto& u: unary) if(eat(u.first)) {
+    auto fn = u.second;
+    res = exp_apply(compile_par(), [fn] (cld x) { return fn(x); });
+    found = true;
+    break;
     }
-  else if(eat("regradius(")) {
-    ld a = rparse(0);
-    force_eat(",");
-    ld b = rparse(0);
+  if(found) ;
+  else if(eat("abs(")) res = exp_apply(compile_par(), [] (cld x) { return cld(abs(x)); });
+  else if(eat("re(")) res = exp_apply(compile_par(), [] (cld x) { return cld(real(x)); });
+  else if(eat("im(")) res = exp_apply(compile_par(), [] (cld x) { return cld(imag(x)); });
+  else if(eat("floor(")) res = exp_apply(compile_par(), [w] (cld x) { return cld(floor(exp_real(x, w))); });
+  else if(eat("frac(")) res = exp_apply(compile_par(), [w] (cld x) { return x - floor(exp_real(x, w)); });
+  else if(eat("to01(")) return exp_apply(compile_par(), [] (cld x) { return atan(x) / ld(M_PI) + ld(0.5); });
+  else if(eat("min(") || eat("max(")) {
+    bool is_max = s[at-2] == 'x';
+    vector<exp_node> args = {compile(0)};
+    while(skip_white(), eat(",")) args.push_back(compile(0));
     force_eat(")");
-    res = edge_of_triangle_with_angles(90._deg, M_PI/a, M_PI/b);
+    res = call(args, [is_max, w] (const exp_args& v) {
+      ld a = exp_real(v[0], w);
+      for(int i=1; i<isize(v); i++) a = is_max ? max(a, exp_real(v[i], w)) : min(a, exp_real(v[i], w));
+      return cld(a);
+      });
     }
-  #if CAP_ARCM
-  else if(eat("arcmedge(")) {
-    vector<pair<ld, ld>> vals = parse_with_reps();
-    force_eat(")");
-    res = euclid ? 1 : arcm::compute_edgelength(vals);
-    if (auto *distunit = hr::at_or_null(extra_params, "distunit"))
-      res /= *distunit;
+  else if(eat("edge(")) res = call(compile_args(2), [w] (const exp_args& v) {
+    return cld(edge_of_triangle_with_angles(TAU/exp_real(v[0], w), M_PI/exp_real(v[1], w), M_PI/exp_real(v[1], w)));
+    }, false);
+  else if(eat("edge_angles(")) {
+    auto args = compile_args(3);
+    int au = find_slot("angleunit");
+    if(au >= 0) args.push_back(exp_dynamic([au] (cld *v) { return v[au]; }));
+    else args.push_back(exp_const(1));
+    return call(args, [w] (const exp_args& v) {
+      return cld(edge_of_triangle_with_angles(real(exp_real(v[0], w) * v[3]), real(exp_real(v[1], w) * v[3]), real(exp_real(v[2], w) * v[3])));
+      }, false);
     }
-  else if(eat("arcmcurv(")) {
-    vector<pair<ld, ld>> vals = parse_with_reps();
+  else if(eat("regradius(")) res = call(compile_args(2), [w] (const exp_args& v) {
+    return cld(edge_of_triangle_with_angles(90._deg, M_PI/exp_real(v[0], w), M_PI/exp_real(v[1], w)));
+    }, false);
+  #if CAP_ARCM
+  else if(eat("arcmedge(") || eat("arcmcurv(")) {
+    bool curv = s[at-2] == 'v';
+    /* arguments are flattened into (value, repetitions) pairs */
+    vector<exp_node> args = {compile(0), exp_const(1)};
+    while(true) {
+      skip_white();
+      if(eat(":^")) args.back() = exp_apply2(args.back(), compile(0), [w] (cld a, cld b) { return a * exp_real(b, w); });
+      if(eat(",")) args.push_back(compile(0)), args.push_back(exp_const(1));
+      else break;
+      }
     force_eat(")");
-    ld total = 0;
-    for(auto p: vals) total += p.second * (180 - 360 / p.first);
-    total = (360 - total) * degree;
-    if(abs(total) < 1e-10) total = 0;
-    res = total;
+    int du = curv ? -1 : find_slot("distunit");
+    if(du >= 0) args.push_back(exp_dynamic([du] (cld *v) { return v[du]; }));
+    else args.push_back(exp_const(1));
+    res = call(args, [curv, w] (const exp_args& v) {
+      vector<pair<ld, ld>> vals;
+      for(int i=0; i+1<isize(v); i+=2) vals.emplace_back(exp_real(v[i], w), real(v[i+1]));
+      if(curv) return cld(arcmcurv_value(vals));
+      return (euclid ? 1 : arcm::compute_edgelength(vals)) / v.back();
+      }, false);
     }
   #endif
-  else if(eat("ideal_angle(")) {
-    ld edges = rparse(0);
-    ld u = 1;
-    skip_white(); if(eat(",")) u = rparse(0);
+  else if(eat("ideal_angle(") || eat("ideal_edge(")) {
+    bool angle = s[at-3] == 'l';
+    vector<exp_node> args = {compile(0)};
+    skip_white(); if(eat(",")) args.push_back(compile(0)); else args.push_back(exp_const(1));
     force_eat(")");
-    return arb::rep_ideal(edges, u).second;
-    }
-  else if(eat("ideal_edge(")) {
-    ld edges = rparse(0);
-    ld u = 1;
-    skip_white(); if(eat(",")) u = rparse(0);
-    force_eat(")");
-    return arb::rep_ideal(edges, u).first;
+    return call(args, [angle, w] (const exp_args& v) {
+      auto p = arb::rep_ideal(exp_real(v[0], w), exp_real(v[1], w));
+      return cld(angle ? p.second : p.first);
+      }, false);
     }
   else if(eat("regangle(")) {
-    cld edgelen = parse(0);
-    if (auto *distunit = hr::at_or_null(extra_params, "distunit")) {
-      edgelen *= *distunit;
-      }
-    
-    force_eat(",");
-    ld edges = rparse(0);
-    force_eat(")");
-    ld alpha = M_PI / edges;
-    if(isinf(edges)) {
-      ld u = sqrt(cosh(validate_real(edgelen)) * 2 - 2);
-      ld a = atan2(1, u/2);
-      res = 2 * a;
+    auto args = compile_args(2);
+    int du = find_slot("distunit"), au = find_slot("angleunit");
+    args.push_back(du >= 0 ? exp_dynamic([du] (cld *v) { return v[du]; }) : exp_const(1));
+    args.push_back(au >= 0 ? exp_dynamic([au] (cld *v) { return v[au]; }) : exp_const(1));
+    res = call(args, [w] (const exp_args& v) {
+      return regangle_value(exp_real(v[0] * v[2], w), exp_real(v[1], w)) / v[3];
+      }, false);
+    }
+  else if(eat("test(")) res = call({compile_par()}, [] (const exp_args& v) {
+    println(hlog, "res = ", v[0], ": ", fts(real(v[0]), 10), ",", fts(imag(v[0]), 10));
+    return v[0];
+    }, false);
+  else if(eat("ifp(") || eat("ifz(")) {
+    bool z = s[at-2] == 'z';
+    auto args = compile_args(3);
+    if(args[0].is_const) {
+      cld cond = args[0].val;
+      res = (z ? abs(cond) < 1e-8 : real(cond) > 0) ? args[1] : args[2];
       }
     else {
-      ld c = asin_auto(sin_auto(validate_real(edgelen)/2) / sin(alpha));
-      hyperpoint h = xpush(c) * spin(M_PI - 2*alpha) * xpush0(c);
-      ld result = 2 * atan2(h);
-      if(result < 0) result = -result;
-      cyclefix(result, 0);
-      res = result;
+      auto cond = args[0].f, yes = args[1].f, no = args[2].f;
+      res = exp_dynamic([z, cond, yes, no] (cld *v) {
+        cld c = cond(v);
+        return (z ? abs(c) < 1e-8 : real(c) > 0) ? yes(v) : no(v);
+        });
       }
-
-    if (auto *angleunit = hr::at_or_null(extra_params, "angleunit"))
-      res /= *angleunit;
     }
-  else if(eat("test(")) {
-    res = parsepar();
-    println(hlog, "res = ", res, ": ", fts(real(res), 10), ",", fts(imag(res), 10));
-    }
-  else if(eat("ifp(")) {
-    cld cond = parse(0);
-    force_eat(",");
-    cld yes = parse(0);
-    force_eat(",");
-    cld no = parsepar();
-    res = real(cond) > 0 ? yes : no;
-    }  
-  else if(eat("ifz(")) {
-    cld cond = parse(0);
-    force_eat(",");
-    cld yes = parse(0);
-    force_eat(",");
-    cld no = parsepar();
-    res = abs(cond) < 1e-8 ? yes : no;
-    }
-  else if(eat("wallif(")) {
-    cld val0 = parse(0);
-    force_eat(",");
-    cld val1 = parsepar();
-    if(real(extra_params["p"]) >= 3.5) res = val0;
-    else res = val1;
-    }
-  else if(eat("rgb(")) {     
-    cld val0 = parse(0);
-    force_eat(",");
-    cld val1 = parse(0);
-    force_eat(",");
-    cld val2 = parsepar();
-    switch(int(real(extra_params["p"]) + .5)) {
-      case 1: res = val0; break;
-      case 2: res = val1; break;
-      case 3: res = val2; break;
-      default: res = 0;
-      }
+  else if(eat("wallif(") || eat("rgb(")) {
+    bool wall = s[at-2] == 'f';
+    auto args = compile_args(wall ? 2 : 3);
+    int ps = find_slot("p");
+    vector<exp_code> codes;
+    for(auto& a: args) codes.push_back(a.f);
+    res = exp_dynamic([wall, ps, codes] (cld *v) {
+      ld p = ps >= 0 ? real(v[ps]) : 0;
+      if(wall) return p >= 3.5 ? codes[0](v) : codes[1](v);
+      int pi = int(p + .5);
+      if(pi >= 1 && pi <= 3) return codes[pi-1](v);
+      return cld(0);
+      });
     }
   else if(eat("let(")) {
     string name = next_token();
     force_eat("=");
-    cld val = parse(0);
+    exp_node val = compile(0);
     force_eat(",");
-    dynamicval<cld> d(extra_params[name], val);
-    res = parsepar();
+    /* the slot index is also the frame index; sequential lets reuse the same slot */
+    int id = isize(slots);
+    frame_size = max(frame_size, id+1);
+    slots.push_back(name);
+    exp_node body = compile_par();
+    slots.pop_back();
+    if(val.is_const && body.is_const) res = body;
+    else {
+      auto vf = val.f, bf = body.f;
+      res = exp_dynamic([id, vf, bf] (cld *v) { v[id] = vf(v); return bf(v); });
+      }
     }
   #if CAP_TEXTURE
   else if(eat("txp(")) {
-    cld val = parsepar();
-    res = texture::get_txp(real(val), imag(val), int(real(extra_params["p"]) + .5)-1);
+    exp_node val = compile_par();
+    int ps = find_slot("p");
+    auto vf = val.f;
+    res = exp_dynamic([vf, ps] (cld *v) {
+      cld x = vf(v);
+      return cld(texture::get_txp(real(x), imag(x), int((ps >= 0 ? real(v[ps]) : 0) + .5)-1));
+      });
     }
   #endif
-  else if(next() == '(') at++, res = parsepar(); 
+  else if(next() == '(') at++, res = compile_par();
   else {
     string number = next_token();
-    if (auto *p = hr::at_or_null(extra_params, number)) res = *p;
-    else if (auto *p = hr::at_or_null(params, number)) res = (*p)->get_cld();
-    else if(number == "e") res = exp(1);
-    else if(number == "i") res = cld(0, 1);
-    else if(number == "inf") res = HUGE_VAL;
-    else if(number == "p" || number == "pi") res = M_PI;
-    else if(number == "" && next() == '-') { at++; res = -parse(20); }
+    int id = find_slot(number);
+    if(id >= 0) res = exp_dynamic([id] (cld *v) { return v[id]; });
+    else if(hr::at_or_null(params, number)) {
+      /* looked up by name on every evaluation, since parameters may be re-registered */
+      res = exp_dynamic([number] (cld*) {
+        auto *p = hr::at_or_null(params, number);
+        if(!p) throw hr_parse_exception("unknown value: " + number);
+        return (*p)->get_cld();
+        });
+      }
+    else if(number == "e") res = exp_const(exp(1));
+    else if(number == "i") res = exp_const(cld(0, 1));
+    else if(number == "inf") res = exp_const(HUGE_VAL);
+    else if(number == "p" || number == "pi") res = exp_const(M_PI);
+    else if(number == "" && next() == '-') { at++; res = exp_apply(compile(20), [] (cld x) { return -x; }); }
     else if(number == "") throw hr_parse_exception("number missing, " + where());
-    else if(number == "s") res = ticks / 1000.;
-    else if(number == "ms") res = ticks;
-    else if(number[0] == '0' && number[1] == 'x') res = strtoll(number.c_str()+2, NULL, 16);
-    else if(number == "mousex") res = mousex;
-    else if(number == "deg") res = degree;
-    else if(number == "ultra_mirror_dist") res = cgi.ultra_mirror_dist;
-    else if(number == "psl_steps") res = cgi.psl_steps;
-    else if(number == "single_step") res = cgi.single_step;
-    else if(number == "step") res = hdist0(tC0(currentmap->adj(cwt.at, 0)));
-    else if(number == "edgelen") res = hdist(get_corner_position(cwt.at, 0), get_corner_position(cwt.at, 1));
-    else if(number == "mousey") res = mousey;
-    else if(number == "random") res = randd();
-    else if(number == "mousez") res = cld(mousex - current_display->xcenter, mousey - current_display->ycenter) / cld(current_display->radius, 0);
-    else if(number == "shot") res = inHighQual ? 1 : 0;
+    else if(number == "s") res = exp_dynamic([] (cld*) { return cld(ticks / 1000.); });
+    else if(number == "ms") res = exp_dynamic([] (cld*) { return cld(ticks); });
+    else if(number[0] == '0' && number[1] == 'x') res = exp_const(strtoll(number.c_str()+2, NULL, 16));
+    else if(number == "mousex") res = exp_dynamic([] (cld*) { return cld(mousex); });
+    else if(number == "deg") res = exp_const(degree);
+    else if(number == "ultra_mirror_dist") res = exp_dynamic([] (cld*) { return cld(cgi.ultra_mirror_dist); });
+    else if(number == "psl_steps") res = exp_dynamic([] (cld*) { return cld(cgi.psl_steps); });
+    else if(number == "single_step") res = exp_dynamic([] (cld*) { return cld(cgi.single_step); });
+    else if(number == "step") res = exp_dynamic([] (cld*) { return cld(hdist0(tC0(currentmap->adj(cwt.at, 0)))); });
+    else if(number == "edgelen") res = exp_dynamic([] (cld*) { return cld(hdist(get_corner_position(cwt.at, 0), get_corner_position(cwt.at, 1))); });
+    else if(number == "mousey") res = exp_dynamic([] (cld*) { return cld(mousey); });
+    else if(number == "random") res = exp_dynamic([] (cld*) { return cld(randd()); });
+    else if(number == "mousez") res = exp_dynamic([] (cld*) { return cld(mousex - current_display->xcenter, mousey - current_display->ycenter) / cld(current_display->radius, 0); });
+    else if(number == "shot") res = exp_dynamic([] (cld*) { return cld(inHighQual ? 1 : 0); });
     #if CAP_ARCM
-    else if(number == "fake_edgelength") res = arcm::fake_current.edgelength;
+    else if(number == "fake_edgelength") res = exp_dynamic([] (cld*) { return cld(arcm::fake_current.edgelength); });
     #endif
-    else if(number == "MAX_EDGE") res = FULL_EDGE;
-    else if(number == "MAX_VALENCE") res = 120;
+    else if(number == "MAX_EDGE") res = exp_const(FULL_EDGE);
+    else if(number == "MAX_VALENCE") res = exp_const(120);
     else if(number[0] >= 'a' && number[0] <= 'z') throw hr_parse_exception("unknown value: " + number);
     else if(number[0] >= 'A' && number[0] <= 'Z') throw hr_parse_exception("unknown value: " + number);
     else if(number[0] == '_') throw hr_parse_exception("unknown value: " + number);
-    else { std::stringstream ss; res = 0; ss << number; ss >> res; }
+    else { std::stringstream ss; cld val = 0; ss << number; ss >> val; res = exp_const(val); }
     }
   while(true) {
     skip_white();
     #if CAP_ANIMATIONS
     if(next() == '.' && next(1) == '.' && prio == 0) {
-      static const cld NO_DERIVATIVE(3.1, 2.5);
-      vector<array<cld, 4>> rest = { make_array(res, NO_DERIVATIVE, res, NO_DERIVATIVE) };
+      exp_node nod = exp_const(NO_DERIVATIVE);
+      vector<array<exp_node, 4>> rest = { make_array(res, nod, res, nod) };
       bool second = true;
       while(next() == '.' && next(1) == '.') {
-        /* spline interpolation */
         if(next(2) == '/') {
           at += 3;
-          rest.back()[second ? 3 : 1] = parse(10);
+          rest.back()[second ? 3 : 1] = compile(10);
           continue;
           }
-        /* sharp end */
         else if(next(2) == '|') {
           at += 3;
-          rest.back()[2] = parse(10);
-          rest.back()[3] = NO_DERIVATIVE;
+          rest.back()[2] = compile(10);
+          rest.back()[3] = nod;
           second = true;
           continue;
           }
-        at += 2; 
-        auto val = parse(10);
-        rest.emplace_back(make_array(val, NO_DERIVATIVE, val, NO_DERIVATIVE));
+        at += 2;
+        auto val = compile(10);
+        rest.emplace_back(make_array(val, nod, val, nod));
         second = false;
         }
-      ld v = ticks * (isize(rest)-1.) / anims::period;
-      int vf = v;
-      v -= vf;
-      if(isize(rest) == 1) rest.push_back(rest[0]);
-      vf %= (isize(rest)-1);
-      auto& lft = rest[vf];
-      auto& rgt = rest[vf+1];
-      if(lft[3] == NO_DERIVATIVE && rgt[1] == NO_DERIVATIVE)
-        res = lerp(lft[2], rgt[0], v);
-      else if(rgt[1] == NO_DERIVATIVE)
-        res = lerp(lft[2] + lft[3] * v, rgt[0], v*v);
-      else if(lft[3] == NO_DERIVATIVE)
-        res = lerp(lft[2], rgt[0] + rgt[1] * (v-1), (2-v)*v);
-      else {
-        res = lerp(lft[2] + lft[3] * v, rgt[0] + rgt[1] * (v-1), v*v*(3-2*v));
-        }
-      return res;
+      vector<exp_node> args;
+      for(auto& r: rest) for(auto& n: r) args.push_back(n);
+      return call(args, [] (const exp_args& v) {
+        vector<array<cld, 4>> rest;
+        for(int i=0; i<isize(v); i+=4) rest.push_back(make_array(v[i], v[i+1], v[i+2], v[i+3]));
+        return spline_value(rest);
+        }, false);
       }
-    else 
+    else
     #endif
-    if(next() == '+' && prio <= 10) at++, res = res + parse(20);
-    else if(next() == '-' && prio <= 10) at++, res = res - parse(20);
-    else if(next() == '*' && prio <= 20) at++, res = res * parse(30);
-    else if(next() == '/' && prio <= 20) at++, res = res / parse(30);
-    else if(next() == '^') at++, res = pow(res, parse(40));
+    if(next() == '+' && prio <= 10) at++, res = exp_apply2(res, compile(20), [] (cld a, cld b) { return a + b; });
+    else if(next() == '-' && prio <= 10) at++, res = exp_apply2(res, compile(20), [] (cld a, cld b) { return a - b; });
+    else if(next() == '*' && prio <= 20) at++, res = exp_apply2(res, compile(30), [] (cld a, cld b) { return a * b; });
+    else if(next() == '/' && prio <= 20) at++, res = exp_apply2(res, compile(30), [] (cld a, cld b) { return a / b; });
+    else if(next() == '^') at++, res = exp_apply2(res, compile(40), [] (cld a, cld b) { return pow(a, b); });
     else break;
     }
   return res;
   }
 
-EX ld parseld(const string& s) {
-  exp_parser ep;
-  ep.s = s;
-  return ep.rparse();
+cld exp_parser::parse(int prio) {
+  slots.clear();
+  for(auto& p: extra_params) slots.push_back(p.first);
+  used.assign(isize(slots), false);
+  frame_size = isize(slots);
+  exp_node n = compile(prio);
+  if(n.is_const) return n.val;
+  vector<cld> frame(frame_size);
+  int id = 0;
+  for(auto& p: extra_params) frame[id++] = p.second;
+  return n.f(frame.data());
   }
 
-EX int parseint(const string& s) {
-  exp_parser ep;
-  ep.s = s;
-  return ep.iparse();
+/** compile the formula s, where the variables named in slots are taken from the frame; throws hr_parse_exception on errors */
+EX compiled_exp compile_exp(const string& s, const vector<string>& slots) {
+  exp_parser ec;
+  ec.s = s;
+  ec.slots = slots;
+  ec.used.assign(isize(slots), false);
+  ec.frame_size = isize(slots);
+  exp_node n = ec.compile();
+  compiled_exp res;
+  res.code = n.f;
+  res.frame_size = ec.frame_size;
+  res.used = ec.used;
+  return res;
   }
 
 EX string available_functions() {
@@ -483,10 +704,61 @@ EX string available_constants() {
   }
 
 #if HDR
+/** \brief the digits of a bignum
+ *
+ *  Behaves like vector<int>, but the first few digits are stored inline, so that
+ *  the small numbers obtained while counting expansions do not need any allocation.
+ */
+struct bignum_digits {
+  static const int INLINE_DIGITS = 4;
+  int sz, cap;
+  int *ptr;
+  int inl[INLINE_DIGITS];
+  bignum_digits() : sz(0), cap(INLINE_DIGITS), ptr(inl) {}
+  bignum_digits(const bignum_digits& b) : bignum_digits() { self = b; }
+  /* noexcept, so that vector<bignum> moves rather than copies when growing; inline digits always fit, so nothing is allocated */
+  bignum_digits(bignum_digits&& b) noexcept : bignum_digits() { self = std::move(b); }
+  ~bignum_digits() { if(ptr != inl) delete[] ptr; }
+  bignum_digits& operator = (const bignum_digits& b) {
+    if(this != &b) { resize(b.sz); for(int i=0; i<sz; i++) ptr[i] = b.ptr[i]; }
+    return self;
+    }
+  bignum_digits& operator = (bignum_digits&& b) noexcept {
+    if(this == &b) return self;
+    if(b.ptr == b.inl) return self = (const bignum_digits&) b;
+    if(ptr != inl) delete[] ptr;
+    ptr = b.ptr; sz = b.sz; cap = b.cap;
+    b.ptr = b.inl; b.sz = 0; b.cap = INLINE_DIGITS;
+    return self;
+    }
+  void reserve(int n) {
+    if(n <= cap) return;
+    int ncap = max(n, 2 * cap);
+    int *nptr = new int[ncap];
+    for(int i=0; i<sz; i++) nptr[i] = ptr[i];
+    if(ptr != inl) delete[] ptr;
+    ptr = nptr; cap = ncap;
+    }
+  void resize(int n) { reserve(n); for(int i=sz; i<n; i++) ptr[i] = 0; sz = n; }
+  void push_back(int x) { reserve(sz+1); ptr[sz++] = x; }
+  void pop_back() { sz--; }
+  void clear() { sz = 0; }
+  int size() const { return sz; }
+  bool empty() const { return !sz; }
+  int& back() { return ptr[sz-1]; }
+  int back() const { return ptr[sz-1]; }
+  int& operator [] (int i) { return ptr[i]; }
+  int operator [] (int i) const { return ptr[i]; }
+  int *begin() { return ptr; }
+  int *end() { return ptr + sz; }
+  const int *begin() const { return ptr; }
+  const int *end() const { return ptr + sz; }
+  };
+
 struct bignum {
   static const int BASE = 1000000000;
   static const long long BASE2 = BASE * (long long)BASE;
-  vector<int> digits;
+  bignum_digits digits;
   bignum() {}
   bignum(int i) : digits() { digits.push_back(i); }
   void be(int i) { digits.resize(1); digits[0] = i; }
@@ -543,6 +815,17 @@ struct bignum {
     if(isize(digits) == 1) return digits[0];
     return digits[0] + digits[1] * (long long) BASE;
     }
+
+  /** true if this is a non-negative number of at most two digits, i.e., approx_ll() is exact */
+  bool is_small() const {
+    return isize(digits) <= 2 && (digits.empty() || digits.back() >= 0);
+    }
+
+  /** set to v (0 <= v < BASE2), using at least min_digits digits */
+  void set_ll(long long v, int min_digits) {
+    digits.clear();
+    while(v || isize(digits) < min_digits) { digits.push_back(int(v % BASE)); v /= BASE; }
+    }
   
   #if CAP_GMP
   mpq_class as_mpq() const {
@@ -559,6 +842,11 @@ struct bignum {
 #endif
 
 bignum& bignum::operator +=(const bignum& b) {
+  if(is_small() && b.is_small()) {
+    /* fast path: both fit in a long long, and so does the sum */
+    set_ll(approx_ll() + b.approx_ll(), max(isize(digits), isize(b.digits)));
+    return self;
+    }
   int K = isize(b.digits);
   if(K > isize(digits)) digits.resize(K);
   int carry = 0;
@@ -602,7 +890,13 @@ bignum bignum::randomized_div(int x) const {
   }
 
 void bignum::addmul(const bignum& b, int factor) {
+  if(is_small() && b.is_small() && factor >= -8 && factor <= 8) {
+    /* fast path: |b * factor| < 8 * BASE2, so everything fits in a long long */
+    long long v = approx_ll() + b.approx_ll() * factor;
+    if(v >= 0) { set_ll(v, 0); return; }
+    }
   int K = isize(b.digits);
+  digits.reserve(max(K, isize(digits)) + 1);
   if(K > isize(digits)) digits.resize(K);
   int carry = 0;
   for(int i=0; i<K || (carry > 0 || carry < -1) || (carry == -1 && i < isize(digits)); i++) {
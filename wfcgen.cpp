@@ -81,31 +81,97 @@ EX void load_probs() {
     }
   }
 
-bool agree(cell *c, probdata& p) {
-  // println(hlog, p);
-  if(isize(p.first) != c->type + 1) return false;
-  int idx = 1;
-  if(c->wall != waChasm && eWall(c->wparam) != p.first[0]) return false;
-  forCellEx(c1, c) {
-    eWall found = p.first[idx++];
-    if(c1->wparam != found && c1->wall != waChasm) return false;
+/** compatibility index for wfc_data: patterns grouped by length (in the map order), with a bitset of matching patterns for every (position, wall) pair */
+struct wfc_index {
+  const wfc_data *source = nullptr;
+  int source_size = -1;
+  struct group {
+    vector<probdata*> entries;
+    int words = 0;
+    /** masks[pos][wall], empty if no pattern has this wall at this position */
+    vector<vector<vector<unsigned long long>>> masks;
+    };
+  vector<group> groups;
+
+  void build(wfc_data& data) {
+    source = &data; source_size = isize(data);
+    groups.clear();
+    for(auto& wp: data) {
+      int len = isize(wp.first);
+      if(len >= isize(groups)) groups.resize(len+1);
+      groups[len].entries.push_back(&wp);
+      }
+    for(int len=0; len<isize(groups); len++) {
+      auto& g = groups[len];
+      g.words = (isize(g.entries) + 63) / 64;
+      g.masks.resize(len);
+      for(int i=0; i<isize(g.entries); i++)
+      for(int pos=0; pos<len; pos++) {
+        int w = g.entries[i]->first[pos];
+        auto& m = g.masks[pos];
+        if(w >= isize(m)) m.resize(w+1);
+        if(m[w].empty()) m[w].resize(g.words, 0);
+        m[w][i/64] |= 1ull << (i%64);
+        }
+      }
     }
-  return true;
+  };
+
+/** the index is rebuilt whenever the data changes; call it before going parallel */
+wfc_index& get_index(wfc_data& data) {
+  static wfc_index idx;
+  if(idx.source != &data || idx.source_size != isize(data)) idx.build(data);
+  return idx;
   }
 
+/** the patterns which agree with the walls already chosen in c and its neighbors (chasms are not chosen yet), in the map order */
 vector<probdata*> gen_picks(cell *c, int& total, wfc_data& data) {
   vector<probdata*> picks;
   total = 0;
-  
-  for(auto& wp: data) {
-    if(!agree(c, wp)) continue;
-    picks.push_back(&wp);
-    total += wp.second;
+
+  auto& idx = get_index(data);
+  int len = c->type + 1;
+  if(len >= isize(idx.groups)) return picks;
+  auto& g = idx.groups[len];
+
+  vector<const vector<unsigned long long>*> required;
+  auto require = [&] (int pos, int w) {
+    auto& m = g.masks[pos];
+    if(w < 0 || w >= isize(m) || m[w].empty()) return false;
+    required.push_back(&m[w]);
+    return true;
+    };
+
+  if(c->wall != waChasm && !require(0, c->wparam)) return picks;
+  int pos = 1;
+  forCellEx(c1, c) {
+    if(c1->wall != waChasm && !require(pos, c1->wparam)) return picks;
+    pos++;
     }
-  
+
+  for(int w=0; w<g.words; w++) {
+    unsigned long long bits = ~0ull;
+    for(auto r: required) bits &= (*r)[w];
+    while(bits) {
+      int i = w * 64 + __builtin_ctzll(bits);
+      bits &= bits - 1;
+      if(i >= isize(g.entries)) break;
+      picks.push_back(g.entries[i]);
+      total += g.entries[i]->second;
+      }
+    }
+
   return picks;
   }
 
+ld entropy_at(cell *c, wfc_data& data) {
+  int total;
+  auto picks = gen_picks(c, total, data);
+  ld entropy = 0;
+  for(auto p: picks) entropy += p->second * log(total * 1. / p->second) / total;
+  return entropy;
+  }
+
 EX vector<cell*> centers;
 
 EX void schedule(cell *c) {
@@ -186,27 +252,49 @@ EX bool use_eclectic = true;
 
 EX void invoke() {
   wfc_data& d = use_eclectic ? eclectic_data() : probs;
+  get_index(d);
 
-  while(isize(centers)) {
-    int pos = -1;
-    ld best_entropy = 1e9;
-    for(int p=0; p<isize(centers); p++) {
-      cell *c = centers[p];
-      int total;
-      
-      auto picks = gen_picks(c, total, d);
-      
-      ld entropy = 0;
-      for(auto p: picks) entropy += p->second * log(total * 1. / p->second) / total;
-      
-      if(entropy < best_entropy) best_entropy = entropy, pos = p;
+  int N = isize(centers);
+  vector<ld> entropy(N);
+  parallel_ranges(N, N >= 256 ? available_threads() : 1, [&] (int from, int to, int) {
+    for(int i=from; i<to; i++) entropy[i] = entropy_at(centers[i], d);
+    });
+
+  /* pending centers are ordered by entropy, and then by the position in centers, so the choices are the same as when scanning all the centers */
+  auto key = [&] (int i) { return make_pair(entropy[i] < 1e9 ? entropy[i] : 1e9, i); };
+  set<pair<ld, int>> pending;
+  std::unordered_map<cell*, vector<int>> where;
+  for(int i=0; i<N; i++) pending.insert(key(i)), where[centers[i]].push_back(i);
+
+  auto update = [&] (cell *c) {
+    auto it = where.find(c);
+    if(it == where.end()) return;
+    for(int i: it->second) {
+      pending.erase(key(i));
+      entropy[i] = entropy_at(c, d);
+      pending.insert(key(i));
       }
-    
+    };
+
+  while(isize(centers)) {
+    int pos = pending.begin()->second;
+    pending.erase(pending.begin());
+
     cell *c = centers[pos];
+    // println(hlog, "chosen ", c, " at entropy ", entropy[pos], " in distance ", c->mpdist);
+    int last = isize(centers) - 1;
+    auto& wc = where[c];
+    wc.erase(std::find(wc.begin(), wc.end(), pos));
+    if(pos != last) {
+      pending.erase(key(last));
+      auto& wl = where[centers[last]];
+      *std::find(wl.begin(), wl.end(), last) = pos;
+      entropy[pos] = entropy[last];
+      pending.insert(key(pos));
+      }
     centers[pos] = centers.back();
     centers.pop_back();
-
-    // println(hlog, "chosen ", c, " at entropy ", best_entropy, " in distance ", c->mpdist);
+    entropy.pop_back();
 
     int total;
     auto picks = gen_picks(c, total, d);
@@ -228,6 +316,12 @@ EX void invoke() {
         }
       }
 
+    /* c and its neighbors have changed, so recompute the entropy of centers within distance 2 */
+    update(c);
+    forCellEx(c1, c) {
+      update(c1);
+      forCellEx(c2, c1) if(c2 != c) update(c2);
+      }
     }
 
   }